@@ -0,0 +1,209 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+#include "bench.hpp"
+
+// Runs every registered benchmark `repeat` times after one warm-up run, writes the median,
+// min and max of each to a JSON file, and compares the medians with a baseline written by an
+// earlier run: a median, and even the fastest run, more than `threshold` percent below the
+// baseline median is a regression, and any regression makes the exit status 1.
+//
+// usage: ./bench_all [-f filter] [-r repeat] [-o results.json] [-b baseline.json] [-t threshold] [-l]
+
+struct Measurement
+{
+    const Benchmark *benchmark;
+    double median;
+    double min;
+    double max;
+    double calibration; // the calibration rate around the runs
+};
+
+// sorts of a fixed random array per second: a fixed amount of work, larger than the caches
+// like most of the benchmarks, that shows how fast the machine is right now
+static double calibration_rate()
+{
+    std::vector<unsigned> values(1 << 20);
+    unsigned seed = 2023;
+    const int rounds = 2;
+    double seconds = measure_seconds([&] {
+        for (int round = 0; round < rounds; ++round)
+        {
+            for (unsigned &value : values)
+            {
+                seed = seed * 1103515245 + 12345;
+                value = seed;
+            }
+            std::sort(values.begin(), values.end());
+        }
+    });
+    return rounds / seconds;
+}
+
+static double median_of(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// every run is preceded by a calibration run, so a machine that gets slower or faster
+// during the runs affects the rates and the calibration alike
+static Measurement measure(const Benchmark &benchmark, int repeat)
+{
+    benchmark.run(); // warm-up: page faults, caches, the CPU frequency
+    std::vector<double> rates;
+    std::vector<double> calibrations;
+    for (int i = 0; i < repeat; ++i)
+    {
+        calibrations.push_back(calibration_rate());
+        rates.push_back(benchmark.run());
+    }
+    auto [min, max] = std::minmax_element(rates.begin(), rates.end());
+    return Measurement{&benchmark, median_of(rates), *min, *max, median_of(calibrations)};
+}
+
+static void write_results(const std::string &file_name, const std::vector<Measurement> &measurements, int repeat)
+{
+    std::ofstream out(file_name);
+    out << std::setprecision(6);
+    out << "{\n  \"repeat\": " << repeat << ",\n  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < measurements.size(); ++i)
+    {
+        const Measurement &m = measurements[i];
+        out << "    {\"name\": \"" << m.benchmark->name << "\", \"unit\": \"" << m.benchmark->unit << "\", \"median\": " << m.median
+            << ", \"min\": " << m.min << ", \"max\": " << m.max << ", \"calibration\": " << m.calibration << "}" << (i + 1 < measurements.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+struct BaselineEntry
+{
+    double median;
+    double calibration; // 0 when the baseline has none
+};
+
+// the entries of a file written by write_results; only its own format is understood
+static std::map<std::string, BaselineEntry> read_baseline(const std::string &file_name)
+{
+    std::map<std::string, BaselineEntry> entries;
+    std::ifstream in(file_name);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t name = line.find("\"name\": \"");
+        size_t median = line.find("\"median\": ");
+        if (name == std::string::npos || median == std::string::npos)
+        {
+            continue;
+        }
+        name += 9;
+        size_t calibration = line.find("\"calibration\": ");
+        entries[line.substr(name, line.find('"', name) - name)] = BaselineEntry{std::stod(line.substr(median + 10)), calibration == std::string::npos ? 0 : std::stod(line.substr(calibration + 15))};
+    }
+    return entries;
+}
+
+int main(int argc, char **argv)
+{
+    std::string filter;
+    int repeat = 5;
+    std::string output_file = "results.json";
+    std::string baseline_file;
+    double threshold = 20;
+    bool list = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "f:r:o:b:t:l")) != -1)
+    {
+        switch (opt)
+        {
+            case 'f': filter = optarg; break;
+            case 'r': repeat = std::max(1, atoi(optarg)); break;
+            case 'o': output_file = optarg; break;
+            case 'b': baseline_file = optarg; break;
+            case 't': threshold = atof(optarg); break;
+            case 'l': list = true; break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-f filter] [-r repeat] [-o results.json] [-b baseline.json] [-t threshold] [-l]" << std::endl;
+                return 2;
+        }
+    }
+
+    // registration order depends on the link order, so the runs go by name
+    std::vector<Benchmark> &registry = benchmarks();
+    std::sort(registry.begin(), registry.end(), [](const Benchmark &a, const Benchmark &b) { return a.name < b.name; });
+    if (list)
+    {
+        for (const Benchmark &benchmark : registry)
+        {
+            std::cout << benchmark.name << " (" << benchmark.unit << ")" << std::endl;
+        }
+        return 0;
+    }
+
+    std::map<std::string, BaselineEntry> baseline;
+    if (!baseline_file.empty())
+    {
+        if (!std::ifstream(baseline_file))
+        {
+            std::cerr << "no baseline at " << baseline_file << ", nothing to compare with" << std::endl;
+        }
+        baseline = read_baseline(baseline_file);
+    }
+
+    std::cout << "repeat: " << repeat << ", hardware threads: " << std::thread::hardware_concurrency() << ", regression threshold: " << threshold << "%" << std::endl;
+    std::vector<Measurement> measurements;
+    int regression_num = 0;
+    for (const Benchmark &benchmark : registry)
+    {
+        if (benchmark.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        Measurement m = measure(benchmark, repeat);
+        measurements.push_back(m);
+
+        std::ostringstream verdict;
+        auto found = baseline.find(benchmark.name);
+        if (found == baseline.end())
+        {
+            verdict << (baseline.empty() ? "" : "new");
+        }
+        else
+        {
+            // the rates are compared relative to the calibration, which takes out how fast the
+            // machine was at the time of each run
+            const BaselineEntry &entry = found->second;
+            double scale = entry.calibration > 0 ? entry.calibration / m.calibration : 1;
+            double change = (m.median * scale / entry.median - 1) * 100;
+            double best_change = (m.max * scale / entry.median - 1) * 100;
+            verdict << std::showpos << std::fixed << std::setprecision(1) << change << "% ";
+            if (change < -threshold && best_change < -threshold) // not just a few slow runs
+            {
+                verdict << "REGRESSION";
+                regression_num++;
+            }
+            else
+            {
+                verdict << (change > threshold ? "improved" : "ok");
+            }
+        }
+        std::cout << std::left << std::setw(30) << benchmark.name << std::right << std::fixed << std::setprecision(2) << std::setw(12) << m.median << " " << std::left << std::setw(16) << benchmark.unit
+                  << std::right << "[" << m.min << ", " << m.max << "]" << (verdict.str().empty() ? "" : "  " + verdict.str()) << std::endl;
+    }
+
+    write_results(output_file, measurements, repeat);
+    std::cout << "Results written to " << output_file << std::endl;
+    if (regression_num > 0)
+    {
+        std::cout << regression_num << " regression(s) against " << baseline_file << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <string>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <functional>
+
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+// One benchmark of the harness. run() does a fixed amount of work on fixed inputs (seeded
+// generators, no wall-clock dependent sizes), so two runs on the same machine do the same
+// thing, and returns the rate it achieved in `unit`; higher is always better.
+struct Benchmark
+{
+    std::string name; // group/test, the key in results.json and the baseline
+    std::string unit;
+    std::function<double()> run;
+};
+
+inline std::vector<Benchmark> &benchmarks()
+{
+    static std::vector<Benchmark> registry;
+    return registry;
+}
+
+// a file-scope `static BenchmarkRegistration` adds a benchmark before main() starts
+struct BenchmarkRegistration
+{
+    BenchmarkRegistration(std::string name, std::string unit, std::function<double()> run)
+    {
+        benchmarks().push_back(Benchmark{std::move(name), std::move(unit), std::move(run)});
+    }
+};
+
+// the seconds body takes
+template <typename Body>
+double measure_seconds(Body &&body)
+{
+    auto begin = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+#endif // !BENCH_HPP
@@ -0,0 +1,79 @@
+#include <random>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include "bench.hpp"
+#include "../lab1/engine.hpp"
+#include "../lab1/customer_queue.hpp"
+
+// the waiting queue of lab1 and the whole bank in virtual time
+
+static constexpr int queue_customer_num = 200000;
+static constexpr int bank_customer_num = 300000;
+static constexpr int bank_server_num = 4;
+
+// Poisson arrivals, one every 10 time units, exponential services with a mean of 35, so the
+// four servers are 87.5% busy and the queues are neither always empty nor ever growing
+static std::vector<Customer> generate_customers(int customer_num)
+{
+    std::mt19937 generator(2023);
+    std::exponential_distribution<double> gap(1.0 / 10);
+    std::exponential_distribution<double> service(1.0 / 35);
+    std::uniform_int_distribution<int> priority(0, 3);
+    std::vector<Customer> customers;
+    customers.reserve(customer_num);
+    double time = 0;
+    for (int i = 0; i < customer_num; ++i)
+    {
+        time += gap(generator);
+        customers.push_back(Customer(i, (int)time + 1, (int)service(generator) + 1, priority(generator)));
+    }
+    return customers;
+}
+
+// every customer pushed, then every customer popped, in the order of the discipline
+static double queue_push_pop(queue_discipline discipline)
+{
+    std::vector<Customer> customers = generate_customers(queue_customer_num);
+    QueueIndex index;
+    for (const Customer &customer : customers)
+    {
+        index.add(customer);
+    }
+    CustomerQueue queue;
+    queue.init(discipline, &index);
+    double seconds = measure_seconds([&] {
+        for (Customer &customer : customers)
+        {
+            queue.push(&customer);
+        }
+        while (!queue.empty())
+        {
+            queue.pop();
+        }
+    });
+    return queue_customer_num / seconds / 1e6;
+}
+
+static BenchmarkRegistration queue_fifo("bank/queue_push_pop_fifo", "M pairs/s", [] { return queue_push_pop(queue_discipline::FIFO); });
+static BenchmarkRegistration queue_sjf("bank/queue_push_pop_sjf", "M pairs/s", [] { return queue_push_pop(queue_discipline::SJF); });
+static BenchmarkRegistration queue_srpt("bank/queue_push_pop_srpt", "M pairs/s", [] { return queue_push_pop(queue_discipline::SRPT); });
+
+// end to end: Engine::simulate over the generated day, the result written to /dev/null
+static double bank_simulate(dispatch_policy policy, queue_discipline discipline)
+{
+    std::vector<Customer> customers = generate_customers(bank_customer_num);
+    std::ostringstream discarded; // the engine reports its destruction on std::cout
+    std::streambuf *cout_buffer = std::cout.rdbuf(discarded.rdbuf());
+    double seconds;
+    {
+        Engine engine(bank_server_num, customers, policy, discipline);
+        engine.set_output_file("/dev/null");
+        seconds = measure_seconds([&] { engine.simulate(); });
+    }
+    std::cout.rdbuf(cout_buffer);
+    return bank_customer_num / seconds / 1e3;
+}
+
+static BenchmarkRegistration bank_shared_fifo("e2e/bank_shared_fifo", "k customers/s", [] { return bank_simulate(dispatch_policy::SHARED, queue_discipline::FIFO); });
+static BenchmarkRegistration bank_p2c_srpt("e2e/bank_p2c_srpt", "k customers/s", [] { return bank_simulate(dispatch_policy::POWER_OF_TWO, queue_discipline::SRPT); });
@@ -0,0 +1,12 @@
+#include "bench.hpp"
+#include "ring_workloads.h"
+
+// the userspace copies of the lab6 rings, between threads of this process
+
+static constexpr size_t ring_size = 65536;
+static constexpr size_t stream_bytes = 256 << 20;
+static constexpr long fanout_messages = 200000;
+
+static BenchmarkRegistration ring_small("ring/mypipe_stream_64b", "MB/s", [] { return ring_stream_mbps(ring_size, 64, stream_bytes / 16); });
+static BenchmarkRegistration ring_large("ring/mypipe_stream_4k", "MB/s", [] { return ring_stream_mbps(ring_size, 4096, stream_bytes); });
+static BenchmarkRegistration broadcast_fanout("ring/broadcast_1x4_256b", "MB/s", [] { return broadcast_fanout_mbps(ring_size, 256, fanout_messages, 4); });
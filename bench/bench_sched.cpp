@@ -0,0 +1,81 @@
+#include <cmath>
+#include <random>
+#include <memory>
+#include <vector>
+#include <functional>
+#include "bench.hpp"
+#include "../lab4/rms.hpp"
+#include "../lab4/edf.hpp"
+#include "../lab4/llf.hpp"
+#include "../lab4/hyperperiod.hpp"
+
+// the lab4 schedulers on a generated periodic task set
+
+static constexpr int strategy_total_time = 1000000;
+static constexpr int runner_total_time = 1000000000;
+static constexpr int runner_run_num = 200;
+
+// Eight periodic tasks with a total utilization of about 0.75, split by UUniFast. The periods
+// divide 240, so the hyperperiod stays short, and late jobs run on, so every run covers the
+// whole horizon whatever the strategy.
+static const std::vector<Task> &generated_tasks()
+{
+    static const std::vector<Task> tasks = [] {
+        const int periods[] = {10, 15, 20, 30, 40, 60, 120, 240};
+        std::mt19937 generator(2023);
+        std::uniform_real_distribution<double> uniform(0, 1);
+        std::vector<Task> tasks;
+        double remaining = 0.75;
+        for (int i = 0; i < 8; ++i)
+        {
+            double utilization = remaining;
+            if (i < 7)
+            {
+                double next = remaining * std::pow(uniform(generator), 1.0 / (7 - i));
+                utilization = remaining - next;
+                remaining = next;
+            }
+            int run_time = std::max(1, (int)std::lround(utilization * periods[i]));
+            tasks.push_back(Task{event_name : (char)('A' + i), is_cycle : true, in_time : i % 3, period_or_stop_time : periods[i], run_time : run_time});
+        }
+        return tasks;
+    }();
+    return tasks;
+}
+
+static Strategy *configure(Strategy *strategy)
+{
+    strategy->set_overload_policy(overload_policy::RUN_LATE);
+    return strategy;
+}
+
+// ticks of Strategy::run per second
+static double strategy_ticks(const std::function<Strategy *()> &make_strategy)
+{
+    JobSet jobs(generated_tasks(), strategy_total_time);
+    std::unique_ptr<Strategy> strategy(make_strategy());
+    double seconds = measure_seconds([&] { strategy->run(jobs, strategy_total_time); });
+    return strategy_total_time / seconds / 1e6;
+}
+
+static BenchmarkRegistration rms_ticks("sched/rms_ticks", "M ticks/s", [] { return strategy_ticks([] { return configure(new RMS()); }); });
+static BenchmarkRegistration edf_ticks("sched/edf_ticks", "M ticks/s", [] { return strategy_ticks([] { return configure(new EDF()); }); });
+static BenchmarkRegistration llf_ticks("sched/llf_ticks", "M ticks/s", [] { return strategy_ticks([] { return configure(new LLF()); }); });
+
+// end to end: whole runs to a long horizon through HyperperiodRunner, which simulates a few
+// hyperperiods and repeats them, job set construction included
+static double runner_runs(const std::function<Strategy *()> &make_strategy)
+{
+    double seconds = measure_seconds([&] {
+        for (int i = 0; i < runner_run_num; ++i)
+        {
+            HyperperiodRunner runner(make_strategy, generated_tasks());
+            runner.run(runner_total_time);
+        }
+    });
+    return runner_run_num / seconds / 1e3;
+}
+
+static BenchmarkRegistration rms_runner("e2e/hyperperiod_rms", "k runs/s", [] { return runner_runs([] { return configure(new RMS()); }); });
+static BenchmarkRegistration edf_runner("e2e/hyperperiod_edf", "k runs/s", [] { return runner_runs([] { return configure(new EDF()); }); });
+static BenchmarkRegistration llf_runner("e2e/hyperperiod_llf", "k runs/s", [] { return runner_runs([] { return configure(new LLF()); }); });
@@ -0,0 +1,64 @@
+#include <thread>
+#include "bench.hpp"
+#include "../common/sync.hpp"
+
+// the primitives of common/sync.hpp with the default backend
+
+using namespace primitives;
+
+static constexpr long sync_iterations = 1000000;
+static constexpr long handoff_iterations = 100000;
+
+// Down/Up pairs on a semaphore nobody else touches
+static BenchmarkRegistration semaphore_down_up("sync/semaphore_down_up", "Mops/s", [] {
+    Semaphore<> sem(1, 1);
+    double seconds = measure_seconds([&] {
+        for (long i = 0; i < sync_iterations; ++i)
+        {
+            sem.Down();
+            sem.Up();
+        }
+    });
+    return sync_iterations / seconds / 1e6;
+});
+
+// two threads hand a token back and forth
+static BenchmarkRegistration semaphore_ping_pong("sync/semaphore_ping_pong", "k round trips/s", [] {
+    Semaphore<> ping(0, 1);
+    Semaphore<> pong(0, 1);
+    double seconds = measure_seconds([&] {
+        std::thread other([&] {
+            for (long i = 0; i < handoff_iterations; ++i)
+            {
+                ping.Down();
+                pong.Up();
+            }
+        });
+        for (long i = 0; i < handoff_iterations; ++i)
+        {
+            ping.Up();
+            pong.Down();
+        }
+        other.join();
+    });
+    return handoff_iterations / seconds / 1e3;
+});
+
+// one producer and one consumer through a small channel
+static BenchmarkRegistration channel_send_receive("sync/channel_send_receive", "Mmsgs/s", [] {
+    Channel<long> channel(64);
+    double seconds = measure_seconds([&] {
+        std::thread consumer([&] {
+            for (long i = 0; i < sync_iterations; ++i)
+            {
+                channel.Receive();
+            }
+        });
+        for (long i = 0; i < sync_iterations; ++i)
+        {
+            channel.Send(i);
+        }
+        consumer.join();
+    });
+    return sync_iterations / seconds / 1e6;
+});
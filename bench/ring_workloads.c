@@ -0,0 +1,111 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "ring_workloads.h"
+#include "../lab6/mypipe_ring.h"
+#include "../lab6/mypipe_broadcast.h"
+
+static double now_seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+struct stream_job
+{
+    struct mypipe_ring *ring;
+    size_t message_size;
+    size_t total_bytes;
+};
+
+static void *stream_reader(void *arg)
+{
+    struct stream_job *job = arg;
+    char *buf = malloc(job->message_size);
+    size_t received = 0;
+    while (received < job->total_bytes)
+    {
+        received += mypipe_ring_read_wait(job->ring, buf, job->message_size);
+    }
+    free(buf);
+    return NULL;
+}
+
+double ring_stream_mbps(size_t ring_size, size_t message_size, size_t total_bytes)
+{
+    struct mypipe_ring *ring = malloc(mypipe_ring_bytes(ring_size));
+    mypipe_ring_init(ring, ring_size, 0);
+    char *buf = malloc(message_size);
+    memset(buf, 'x', message_size);
+    struct stream_job job = {ring, message_size, total_bytes};
+
+    double begin = now_seconds();
+    pthread_t reader;
+    pthread_create(&reader, NULL, stream_reader, &job);
+    size_t sent = 0;
+    while (sent < total_bytes)
+    {
+        size_t offset = sent % message_size;
+        sent += mypipe_ring_write_wait(ring, buf + offset, min(message_size - offset, total_bytes - sent));
+    }
+    pthread_join(reader, NULL);
+    double seconds = now_seconds() - begin;
+
+    free(buf);
+    mypipe_ring_destroy(ring);
+    free(ring);
+    return total_bytes / seconds / 1e6;
+}
+
+struct fanout_job
+{
+    struct mypipe_broadcast *ring;
+    int reader;
+    size_t message_size;
+    long message_num;
+};
+
+static void *fanout_reader(void *arg)
+{
+    struct fanout_job *job = arg;
+    char *buf = malloc(job->message_size);
+    for (long i = 0; i < job->message_num; i++)
+    {
+        mypipe_broadcast_read_wait(job->ring, job->reader, buf, job->message_size);
+    }
+    free(buf);
+    return NULL;
+}
+
+double broadcast_fanout_mbps(size_t ring_size, size_t message_size, long message_num, int reader_num)
+{
+    struct mypipe_broadcast *ring = aligned_alloc(MYPIPE_BROADCAST_CACHE_LINE, mypipe_broadcast_bytes(ring_size));
+    mypipe_broadcast_init(ring, ring_size, reader_num);
+    char *buf = malloc(message_size);
+    memset(buf, 'x', message_size);
+    struct fanout_job jobs[MYPIPE_BROADCAST_MAX_READERS];
+    pthread_t readers[MYPIPE_BROADCAST_MAX_READERS];
+
+    double begin = now_seconds();
+    for (int i = 0; i < reader_num; i++)
+    {
+        jobs[i] = (struct fanout_job){ring, i, message_size, message_num};
+        pthread_create(&readers[i], NULL, fanout_reader, &jobs[i]);
+    }
+    for (long i = 0; i < message_num; i++)
+    {
+        mypipe_broadcast_write_wait(ring, buf, message_size);
+    }
+    for (int i = 0; i < reader_num; i++)
+    {
+        pthread_join(readers[i], NULL);
+    }
+    double seconds = now_seconds() - begin;
+
+    free(buf);
+    free(ring);
+    return (double)message_size * message_num * reader_num / seconds / 1e6;
+}
@@ -0,0 +1,23 @@
+#ifndef RING_WORKLOADS_H
+#define RING_WORKLOADS_H
+
+#include <stddef.h>
+
+// The lab6 rings are C (the broadcast ring uses C11 atomics), so their workloads are built as
+// C and called from bench_ring.cpp. Both run on threads of this process and return MB/s.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// one writer streams total_bytes through a mypipe ring in writes of message_size, one reader drains it
+double ring_stream_mbps(size_t ring_size, size_t message_size, size_t total_bytes);
+
+// one writer broadcasts message_num records to reader_num readers; counts every delivered byte
+double broadcast_fanout_mbps(size_t ring_size, size_t message_size, long message_num, int reader_num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // !RING_WORKLOADS_H
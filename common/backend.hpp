@@ -0,0 +1,127 @@
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <climits>
+#include <condition_variable>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#ifndef BACKEND_HPP
+#define BACKEND_HPP
+
+namespace primitives
+{
+
+// A backend parks a thread until a 32-bit atomic word changes from an expected value.
+// Every primitive in sync.hpp is built on wait/wake_one/wake_all, so the way threads
+// block is selected by a template parameter and costs nothing at runtime.
+
+// mutex + condition variable, the behaviour of the original Semaphore classes
+class CondvarBackend
+{
+public:
+    static constexpr const char *name = "condvar";
+
+    void wait(std::atomic<int> &word, int expected)
+    {
+        std::unique_lock<std::mutex> lg{mtx};
+        while (word.load() == expected)
+        {
+            cv.wait(lg);
+        }
+    }
+
+    void wake_one(std::atomic<int> &)
+    {
+        std::unique_lock<std::mutex> lg{mtx}; // a waiter between its check and cv.wait holds the lock
+        cv.notify_one();
+    }
+
+    void wake_all(std::atomic<int> &)
+    {
+        std::unique_lock<std::mutex> lg{mtx};
+        cv.notify_all();
+    }
+
+private:
+    std::condition_variable cv;
+    mutable std::mutex mtx;
+};
+
+// Linux futex on the word itself, no extra lock is taken on either side
+class FutexBackend
+{
+public:
+    static constexpr const char *name = "futex";
+
+    void wait(std::atomic<int> &word, int expected)
+    {
+        while (word.load() == expected)
+        {
+            syscall(SYS_futex, address(word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+        }
+    }
+
+    void wake_one(std::atomic<int> &word)
+    {
+        syscall(SYS_futex, address(word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    void wake_all(std::atomic<int> &word)
+    {
+        syscall(SYS_futex, address(word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+private:
+    static int *address(std::atomic<int> &word)
+    {
+        static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex word must be a plain int");
+        return reinterpret_cast<int *>(&word);
+    }
+};
+
+// busy waiting, falls back to yield so that it still makes progress on a single core
+class SpinBackend
+{
+public:
+    static constexpr const char *name = "spin";
+
+    void wait(std::atomic<int> &word, int expected)
+    {
+        int spins = 0;
+        while (word.load(std::memory_order_acquire) == expected)
+        {
+            if (++spins < max_spins)
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                __builtin_ia32_pause();
+#endif
+            }
+            else
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    void wake_one(std::atomic<int> &) {}
+
+    void wake_all(std::atomic<int> &) {}
+
+private:
+    static constexpr int max_spins = 1024;
+};
+
+// selected with -DSYNC_BACKEND_FUTEX or -DSYNC_BACKEND_SPIN, condvar otherwise
+#if defined(SYNC_BACKEND_FUTEX)
+using DefaultBackend = FutexBackend;
+#elif defined(SYNC_BACKEND_SPIN)
+using DefaultBackend = SpinBackend;
+#else
+using DefaultBackend = CondvarBackend;
+#endif
+
+} // namespace primitives
+
+#endif // !BACKEND_HPP
@@ -0,0 +1,275 @@
+#include <mutex>
+#include <chrono>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <ostream>
+#include <iomanip>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+namespace primitives
+{
+
+// Contention profiling of the semaphores, built with -DSYNC_PROFILE. Every Semaphore then
+// counts its acquires, the acquires that had to block, how long they blocked and how many
+// threads were queued at once. The counters live in a table per thread, so an uncontended
+// Down() touches no shared line; a thread merges its table into the registry when it exits,
+// and the report, sorted by total blocked time, is printed to stderr at process exit.
+// Without SYNC_PROFILE every hook is an empty inline function and the profile is an empty
+// member, so the semaphores are unchanged.
+
+#ifdef SYNC_PROFILE
+
+namespace profiling
+{
+
+using profile_clock = std::chrono::steady_clock;
+
+// wait times in ns: 4 buckets per power of two, so a percentile is within 19%
+constexpr int sub_buckets = 4;
+constexpr int bucket_num = 64 * sub_buckets;
+
+inline int bucket_of(uint64_t ns)
+{
+    if (ns < sub_buckets)
+    {
+        return (int)ns;
+    }
+    int log = 63 - __builtin_clzll(ns);
+    return log * sub_buckets + (int)((ns >> (log - 2)) & (sub_buckets - 1));
+}
+
+// the largest wait that falls in a bucket
+inline uint64_t bucket_limit(int bucket)
+{
+    if (bucket < sub_buckets)
+    {
+        return bucket;
+    }
+    int log = bucket / sub_buckets;
+    return ((uint64_t)(sub_buckets + bucket % sub_buckets + 1) << (log - 2)) - 1;
+}
+
+struct Counters
+{
+    uint64_t acquires = 0;
+    uint64_t contended = 0;
+    uint64_t total_wait = 0; // ns
+    uint64_t max_wait = 0;
+    int max_depth = 0; // waiters at once, counting the one that just blocked
+    uint64_t histogram[bucket_num] = {};
+
+    void merge(const Counters &other)
+    {
+        acquires += other.acquires;
+        contended += other.contended;
+        total_wait += other.total_wait;
+        max_wait = std::max(max_wait, other.max_wait);
+        max_depth = std::max(max_depth, other.max_depth);
+        for (int i = 0; i < bucket_num; ++i)
+        {
+            histogram[i] += other.histogram[i];
+        }
+    }
+
+    // the smallest bucket limit at or above quantile q of the contended acquires
+    uint64_t percentile(double q) const
+    {
+        uint64_t rank = (uint64_t)(q * contended);
+        uint64_t seen = 0;
+        for (int i = 0; i < bucket_num; ++i)
+        {
+            seen += histogram[i];
+            if (seen > rank)
+            {
+                return std::min(bucket_limit(i), max_wait);
+            }
+        }
+        return max_wait;
+    }
+};
+
+// the counters merged from the exited threads, by semaphore id
+class Registry
+{
+public:
+    Registry()
+    {
+        std::atexit([]() { registry().report(std::cerr); });
+    }
+
+    static Registry &registry()
+    {
+        static Registry *instance = new Registry; // never destroyed, threads may exit after main
+        return *instance;
+    }
+
+    void set_name(uint64_t id, std::string name)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        names[id] = std::move(name);
+    }
+
+    void merge(const std::unordered_map<uint64_t, Counters> &table)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        for (auto &[id, counters] : table)
+        {
+            merged[id].merge(counters);
+        }
+    }
+
+    // one row per semaphore that was acquired; threads still running are not counted
+    void report(std::ostream &out)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        std::vector<std::pair<uint64_t, const Counters *>> rows;
+        for (auto &[id, counters] : merged)
+        {
+            if (counters.acquires > 0)
+            {
+                rows.emplace_back(id, &counters);
+            }
+        }
+        if (rows.empty())
+        {
+            return;
+        }
+        std::sort(rows.begin(), rows.end(), [](auto &a, auto &b) { return a.second->total_wait > b.second->total_wait; });
+
+        out << "semaphore contention, by total blocked time (waits in us)" << std::endl;
+        out << std::left << std::setw(24) << "semaphore" << std::right << std::setw(12) << "acquires" << std::setw(12) << "contended" << std::setw(14) << "blocked(ms)"
+            << std::setw(10) << "p50" << std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(12) << "max" << std::setw(8) << "queue" << std::endl;
+        for (auto &[id, counters] : rows)
+        {
+            auto name = names.find(id);
+            std::string label = name != names.end() ? name->second : "#" + std::to_string(id);
+            out << std::left << std::setw(24) << label << std::right << std::setw(12) << counters->acquires << std::setw(12) << counters->contended
+                << std::fixed << std::setprecision(3) << std::setw(14) << counters->total_wait / 1e6 << std::setprecision(1)
+                << std::setw(10) << counters->percentile(0.5) / 1e3 << std::setw(10) << counters->percentile(0.9) / 1e3 << std::setw(10) << counters->percentile(0.99) / 1e3
+                << std::setw(12) << counters->max_wait / 1e3 << std::setw(8) << counters->max_depth << std::endl;
+        }
+    }
+
+private:
+    std::mutex mtx;
+    std::unordered_map<uint64_t, std::string> names;
+    std::unordered_map<uint64_t, Counters> merged;
+};
+
+// the counters of the current thread, merged into the registry when it exits
+class ThreadTable
+{
+public:
+    ThreadTable()
+    {
+        Registry::registry(); // registers the report before the table can be destroyed
+    }
+
+    ~ThreadTable()
+    {
+        Registry::registry().merge(table);
+    }
+
+    static Counters &counters(uint64_t id)
+    {
+        static thread_local ThreadTable local;
+        if (id != local.last_id)
+        {
+            local.last = &local.table[id]; // references into an unordered_map stay valid
+            local.last_id = id;
+        }
+        return *local.last;
+    }
+
+private:
+    std::unordered_map<uint64_t, Counters> table;
+    uint64_t last_id = 0;
+    Counters *last = nullptr;
+};
+
+} // namespace profiling
+
+// the profile of one semaphore; a copy is another semaphore with its own counters
+class SemaphoreProfile
+{
+public:
+    // when the current acquire first blocked, if it did
+    struct Wait
+    {
+        profiling::profile_clock::time_point begin{};
+        bool blocked = false;
+    };
+
+    SemaphoreProfile() : id(next_id()) {}
+    SemaphoreProfile(const SemaphoreProfile &) : id(next_id()) {}
+    SemaphoreProfile &operator=(const SemaphoreProfile &) = delete;
+
+    void name(std::string name)
+    {
+        profiling::Registry::registry().set_name(id, std::move(name));
+    }
+
+    // the acquire is about to block with `depth` threads waiting, itself included
+    void block(Wait &wait, int depth)
+    {
+        profiling::Counters &counters = profiling::ThreadTable::counters(id);
+        counters.max_depth = std::max(counters.max_depth, depth);
+        if (!wait.blocked)
+        {
+            wait.begin = profiling::profile_clock::now();
+            wait.blocked = true;
+        }
+    }
+
+    void acquired(const Wait &wait)
+    {
+        profiling::Counters &counters = profiling::ThreadTable::counters(id);
+        counters.acquires++;
+        if (wait.blocked)
+        {
+            uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(profiling::profile_clock::now() - wait.begin).count();
+            counters.contended++;
+            counters.total_wait += ns;
+            counters.max_wait = std::max(counters.max_wait, ns);
+            counters.histogram[profiling::bucket_of(ns)]++;
+        }
+    }
+
+private:
+    static uint64_t next_id()
+    {
+        static std::atomic<uint64_t> ids{1};
+        return ids++;
+    }
+
+    uint64_t id;
+};
+
+#else
+
+class SemaphoreProfile
+{
+public:
+    struct Wait
+    {
+    };
+
+    void name(const std::string &) {}
+    void block(Wait &, int) {}
+    void acquired(const Wait &) {}
+};
+
+#endif
+
+} // namespace primitives
+
+#endif // !PROFILE_HPP
@@ -0,0 +1,236 @@
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+#include <unistd.h>
+
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+namespace snapshot
+{
+
+// Checkpoint files of the simulators. A checkpoint is a flat sequence of plain records and
+// arrays of them, copied byte for byte, so saving is one write per array and loading one
+// read of the file and a memcpy per array; nothing is parsed or converted. The file starts with a tag of the
+// writer, a format version and the payload size, and it is replaced atomically (written next
+// to it, then renamed), so a crash while saving leaves the previous checkpoint intact. The
+// layout is that of the machine that wrote it.
+constexpr uint32_t version = 1;
+
+class Writer
+{
+public:
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    // the checkpoint is written next to file and replaces it in commit()
+    Writer(const std::string &file, const char tag[4]) : file(file), temp(file + ".tmp")
+    {
+        out = std::fopen(temp.c_str(), "wb");
+        if (out == nullptr)
+        {
+            throw std::runtime_error{"Cannot write the checkpoint " + temp};
+        }
+        std::setvbuf(out, nullptr, _IOFBF, 1 << 20);
+        write(tag, 4);
+        put(version);
+        put(uint64_t(0)); // payload size, filled in by commit()
+    }
+
+    ~Writer()
+    {
+        if (out != nullptr)
+        {
+            std::fclose(out);
+            std::remove(temp.c_str());
+        }
+    }
+
+    template <typename T>
+    void put(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain records can be saved");
+        write(&value, sizeof(T));
+    }
+
+    // an array is its length followed by its elements
+    template <typename T>
+    void put_array(const T *data, size_t n)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain records can be saved");
+        put(uint64_t(n));
+        write(data, n * sizeof(T));
+    }
+
+    template <typename T>
+    void put_vector(const std::vector<T> &values)
+    {
+        put_array(values.data(), values.size());
+    }
+
+    size_t size() const
+    {
+        return written;
+    }
+
+    // complete the checkpoint and put it in place of the previous one
+    void commit()
+    {
+        uint64_t payload = written - header_size;
+        bool ok = !failed && std::fseek(out, 8, SEEK_SET) == 0 && std::fwrite(&payload, sizeof(payload), 1, out) == 1;
+        ok = std::fclose(out) == 0 && ok;
+        out = nullptr;
+        if (!ok || std::rename(temp.c_str(), file.c_str()) != 0)
+        {
+            std::remove(temp.c_str());
+            throw std::runtime_error{"Cannot write the checkpoint " + file};
+        }
+    }
+
+    static constexpr size_t header_size = 16;
+
+private:
+    // large arrays go straight from memory to the file, bypassing the stdio buffer
+    void write(const void *data, size_t n)
+    {
+        failed = failed || std::fwrite(data, 1, n, out) != n;
+        written += n;
+    }
+
+    std::string file;
+    std::string temp;
+    FILE *out = nullptr;
+    size_t written = 0;
+    bool failed = false;
+};
+
+class Reader
+{
+public:
+    // the whole checkpoint is read at once; a missing file, another tag or a truncated file throws
+    Reader(const std::string &file, const char tag[4])
+    {
+        FILE *in = std::fopen(file.c_str(), "rb");
+        if (in == nullptr)
+        {
+            throw std::runtime_error{"Cannot read the checkpoint " + file};
+        }
+        std::fseek(in, 0, SEEK_END);
+        buffer.resize(std::max<long>(std::ftell(in), 0));
+        std::fseek(in, 0, SEEK_SET);
+        size_t read = std::fread(buffer.data(), 1, buffer.size(), in);
+        std::fclose(in);
+        buffer.resize(read);
+
+        if (buffer.size() < Writer::header_size || std::memcmp(buffer.data(), tag, 4) != 0)
+        {
+            throw std::runtime_error{file + " is not a checkpoint of this program"};
+        }
+        position = 4;
+        uint64_t payload = 0;
+        if (get<uint32_t>() != version || (payload = get<uint64_t>()) != buffer.size() - Writer::header_size)
+        {
+            throw std::runtime_error{file + " is truncated or of another version"};
+        }
+    }
+
+    template <typename T>
+    T get()
+    {
+        T value;
+        get(value);
+        return value;
+    }
+
+    template <typename T>
+    void get(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain records can be loaded");
+        take(&value, sizeof(T));
+    }
+
+    template <typename T>
+    std::vector<T> get_vector()
+    {
+        uint64_t n = get<uint64_t>();
+        if (n > (buffer.size() - position) / sizeof(T))
+        {
+            throw std::runtime_error{"The checkpoint is truncated"};
+        }
+        std::vector<T> values(n);
+        take(values.data(), values.size() * sizeof(T));
+        return values;
+    }
+
+    // an array whose length the caller knows already
+    template <typename T>
+    void get_array(T *data, size_t n)
+    {
+        if (get<uint64_t>() != n)
+        {
+            throw std::runtime_error{"The checkpoint does not match this run"};
+        }
+        take(data, n * sizeof(T));
+    }
+
+private:
+    void take(void *data, size_t n)
+    {
+        if (buffer.size() - position < n)
+        {
+            throw std::runtime_error{"The checkpoint is truncated"};
+        }
+        std::memcpy(data, buffer.data() + position, n);
+        position += n;
+    }
+
+    std::string buffer;
+    size_t position = 0;
+};
+
+// An append-only array kept next to a checkpoint (results, dropped jobs, changed rows), so
+// that a checkpoint only writes what was added since the previous one and stores the length.
+// restart starts the log over.
+template <typename T>
+void append_log(const std::string &file, const T *data, size_t n, bool restart)
+{
+    static_assert(std::is_trivially_copyable<T>::value, "only plain records can be saved");
+    FILE *out = std::fopen(file.c_str(), restart ? "wb" : "ab");
+    if (out == nullptr)
+    {
+        throw std::runtime_error{"Cannot write the checkpoint log " + file};
+    }
+    bool written = std::fwrite(data, sizeof(T), n, out) == n;
+    if (std::fclose(out) != 0 || !written)
+    {
+        throw std::runtime_error{"Cannot write the checkpoint log " + file};
+    }
+}
+
+// the first n elements of a log; what a checkpoint that was never completed appended after
+// them is cut off, so the log can be appended to again
+template <typename T>
+std::vector<T> read_log(const std::string &file, size_t n)
+{
+    std::vector<T> values(n);
+    FILE *in = std::fopen(file.c_str(), "rb");
+    size_t read = in != nullptr ? std::fread(values.data(), sizeof(T), n, in) : 0;
+    if (in != nullptr)
+    {
+        std::fclose(in);
+    }
+    if (read != n || truncate(file.c_str(), n * sizeof(T)) != 0)
+    {
+        throw std::runtime_error{"The checkpoint log " + file + " is incomplete"};
+    }
+    return values;
+}
+
+} // namespace snapshot
+
+#endif // !SNAPSHOT_HPP
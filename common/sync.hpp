@@ -0,0 +1,327 @@
+#include <atomic>
+#include <vector>
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include "backend.hpp"
+#include "profile.hpp"
+
+#ifndef SYNC_HPP
+#define SYNC_HPP
+
+namespace primitives
+{
+
+// counting semaphore with an upper bound, Up() on a full semaphore throws
+template <typename Backend = DefaultBackend>
+class Semaphore
+{
+public:
+    Semaphore &operator=(const Semaphore &) = delete;
+
+    ~Semaphore() = default;
+
+    Semaphore(int init_count, int max_count) : cnt(init_count), max(max_count)
+    {
+        if (init_count < 0 || max_count <= 0 || init_count > max_count)
+        {
+            throw std::invalid_argument{"Invalid argument!"};
+        }
+    }
+
+    // copies the count, not the waiters
+    Semaphore(const Semaphore &sem) : cnt(sem.cnt.load()), max(sem.max) {}
+
+    // the label of this semaphore in the contention report (-DSYNC_PROFILE)
+    void SetName(const std::string &name)
+    {
+        profile.name(name);
+    }
+
+    void Down()
+    {
+        SemaphoreProfile::Wait wait;
+        while (true)
+        {
+            int c = cnt.load();
+            while (c > 0)
+            {
+                if (cnt.compare_exchange_weak(c, c - 1))
+                {
+                    profile.acquired(wait);
+                    return;
+                }
+            }
+            profile.block(wait, ++waiters);
+            backend.wait(cnt, 0);
+            waiters--;
+        }
+    }
+
+    bool TryDown()
+    {
+        int c = cnt.load();
+        while (c > 0)
+        {
+            if (cnt.compare_exchange_weak(c, c - 1))
+            {
+                profile.acquired(SemaphoreProfile::Wait{});
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // take exactly n units at once
+    void Down(int n)
+    {
+        SemaphoreProfile::Wait wait;
+        while (true)
+        {
+            int c = cnt.load();
+            while (c >= n)
+            {
+                if (cnt.compare_exchange_weak(c, c - n))
+                {
+                    profile.acquired(wait);
+                    return;
+                }
+            }
+            batch_waiters++;
+            profile.block(wait, ++waiters);
+            backend.wait(cnt, c);
+            waiters--;
+            batch_waiters--;
+        }
+    }
+
+    // wait for at least one unit, then take as many as available up to n
+    int DownUpTo(int n)
+    {
+        SemaphoreProfile::Wait wait;
+        while (true)
+        {
+            int c = cnt.load();
+            while (c > 0)
+            {
+                int taken = c < n ? c : n;
+                if (cnt.compare_exchange_weak(c, c - taken))
+                {
+                    profile.acquired(wait);
+                    return taken;
+                }
+            }
+            profile.block(wait, ++waiters);
+            backend.wait(cnt, 0);
+            waiters--;
+        }
+    }
+
+    void Up()
+    {
+        Up(1);
+    }
+
+    void Up(int n)
+    {
+        int c = cnt.load();
+        do
+        {
+            if (c + n > max)
+            {
+                throw std::overflow_error{"The semaphore is full!"};
+            }
+        } while (!cnt.compare_exchange_weak(c, c + n));
+
+        if (waiters.load() > 0)
+        {
+            // a batch waiter may need more than one unit, so it cannot consume the only wakeup
+            if (n == 1 && batch_waiters.load() == 0)
+            {
+                backend.wake_one(cnt);
+            }
+            else
+            {
+                backend.wake_all(cnt);
+            }
+        }
+    }
+
+    // release every waiter, used to shut down consumers
+    void WakeUpAll()
+    {
+        cnt = max;
+        backend.wake_all(cnt);
+    }
+
+    int Count() const
+    {
+        return cnt.load();
+    }
+
+private:
+    std::atomic<int> cnt;
+    int max;
+    std::atomic<int> waiters{0};
+    std::atomic<int> batch_waiters{0};
+    Backend backend;
+    [[no_unique_address]] SemaphoreProfile profile;
+};
+
+template <typename Backend = DefaultBackend>
+class BinarySemaphore : public Semaphore<Backend>
+{
+public:
+    explicit BinarySemaphore(bool init = false) : Semaphore<Backend>(init ? 1 : 0, 1) {}
+};
+
+// manual-reset event, Wait() returns as long as the event is set
+template <typename Backend = DefaultBackend>
+class Event
+{
+public:
+    Event(const Event &) = delete;
+    Event &operator=(const Event &) = delete;
+
+    explicit Event(bool init = false) : state(init ? 1 : 0) {}
+
+    void Set()
+    {
+        state = 1;
+        backend.wake_all(state);
+    }
+
+    void Reset()
+    {
+        state = 0;
+    }
+
+    void Wait()
+    {
+        backend.wait(state, 0);
+    }
+
+    bool IsSet() const
+    {
+        return state.load() != 0;
+    }
+
+private:
+    std::atomic<int> state;
+    Backend backend;
+};
+
+// reusable barrier for a fixed number of threads
+template <typename Backend = DefaultBackend>
+class Barrier
+{
+public:
+    Barrier(const Barrier &) = delete;
+    Barrier &operator=(const Barrier &) = delete;
+
+    explicit Barrier(int thread_num) : thread_num(thread_num)
+    {
+        if (thread_num <= 0)
+        {
+            throw std::invalid_argument{"Invalid argument!"};
+        }
+    }
+
+    void ArriveAndWait()
+    {
+        int gen = generation.load();
+        if (arrived.fetch_add(1) + 1 == thread_num)
+        {
+            arrived = 0;
+            generation++;
+            backend.wake_all(generation);
+            return;
+        }
+        backend.wait(generation, gen);
+    }
+
+private:
+    int thread_num;
+    std::atomic<int> arrived{0};
+    std::atomic<int> generation{0};
+    Backend backend;
+};
+
+// bounded multi-producer multi-consumer channel
+template <typename T, typename Backend = DefaultBackend>
+class Channel
+{
+public:
+    Channel(const Channel &) = delete;
+    Channel &operator=(const Channel &) = delete;
+
+    explicit Channel(int capacity) : buffer(capacity), slots(capacity, capacity), items(0, capacity), lock(true) {}
+
+    void Send(T value)
+    {
+        slots.Down();
+        push(std::move(value));
+    }
+
+    bool TrySend(T value)
+    {
+        if (!slots.TryDown())
+        {
+            return false;
+        }
+        push(std::move(value));
+        return true;
+    }
+
+    T Receive()
+    {
+        items.Down();
+        return pop();
+    }
+
+    bool TryReceive(T &value)
+    {
+        if (!items.TryDown())
+        {
+            return false;
+        }
+        value = pop();
+        return true;
+    }
+
+    int Size() const
+    {
+        return items.Count();
+    }
+
+private:
+    void push(T value)
+    {
+        lock.Down();
+        buffer[tail] = std::move(value);
+        tail = (tail + 1) % buffer.size();
+        lock.Up();
+        items.Up();
+    }
+
+    T pop()
+    {
+        lock.Down();
+        T value = std::move(buffer[head]);
+        head = (head + 1) % buffer.size();
+        lock.Up();
+        slots.Up();
+        return value;
+    }
+
+    std::vector<T> buffer;
+    size_t head = 0;
+    size_t tail = 0;
+    Semaphore<Backend> slots;
+    Semaphore<Backend> items;
+    BinarySemaphore<Backend> lock;
+};
+
+} // namespace primitives
+
+#endif // !SYNC_HPP
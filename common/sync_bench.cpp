@@ -0,0 +1,133 @@
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <chrono>
+#include <string>
+#include <functional>
+#include "sync.hpp"
+
+// compare the cost of every primitive under each backend
+//
+// usage: ./sync_bench [iterations]
+
+using namespace primitives;
+
+static double measure_ns(long iterations, const std::function<void()> &body)
+{
+    auto begin = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / iterations;
+}
+
+static void report(const char *backend, const char *test, double ns_per_op)
+{
+    std::cout << std::left << std::setw(10) << backend << std::setw(26) << test
+              << std::right << std::fixed << std::setprecision(1) << std::setw(12) << ns_per_op << " ns/op" << std::endl;
+}
+
+template <typename Backend>
+void bench_backend(long iterations)
+{
+    // Down/Up pairs on a semaphore nobody else touches
+    {
+        Semaphore<Backend> sem(1, 1);
+        double ns = measure_ns(iterations, [&] {
+            for (long i = 0; i < iterations; ++i)
+            {
+                sem.Down();
+                sem.Up();
+            }
+        });
+        report(Backend::name, "uncontended down/up", ns);
+    }
+
+    // two threads hand a token back and forth
+    {
+        Semaphore<Backend> ping(0, 1);
+        Semaphore<Backend> pong(0, 1);
+        double ns = measure_ns(iterations, [&] {
+            std::thread other([&] {
+                for (long i = 0; i < iterations; ++i)
+                {
+                    ping.Down();
+                    pong.Up();
+                }
+            });
+            for (long i = 0; i < iterations; ++i)
+            {
+                ping.Up();
+                pong.Down();
+            }
+            other.join();
+        });
+        report(Backend::name, "ping-pong round trip", ns);
+    }
+
+    // one producer and one consumer through a small channel
+    {
+        Channel<long, Backend> channel(64);
+        double ns = measure_ns(iterations, [&] {
+            std::thread consumer([&] {
+                for (long i = 0; i < iterations; ++i)
+                {
+                    channel.Receive();
+                }
+            });
+            for (long i = 0; i < iterations; ++i)
+            {
+                channel.Send(i);
+            }
+            consumer.join();
+        });
+        report(Backend::name, "channel send/receive", ns);
+    }
+
+    // two threads meeting at a barrier
+    {
+        long rounds = iterations / 10 + 1;
+        Barrier<Backend> barrier(2);
+        double ns = measure_ns(rounds, [&] {
+            std::thread other([&] {
+                for (long i = 0; i < rounds; ++i)
+                {
+                    barrier.ArriveAndWait();
+                }
+            });
+            for (long i = 0; i < rounds; ++i)
+            {
+                barrier.ArriveAndWait();
+            }
+            other.join();
+        });
+        report(Backend::name, "barrier round", ns);
+    }
+
+    // set/wait/reset of an event on one thread
+    {
+        Event<Backend> event;
+        double ns = measure_ns(iterations, [&] {
+            for (long i = 0; i < iterations; ++i)
+            {
+                event.Set();
+                event.Wait();
+                event.Reset();
+            }
+        });
+        report(Backend::name, "event set/wait/reset", ns);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = 200000;
+    if (argc > 1)
+    {
+        iterations = std::stol(argv[1]);
+    }
+    std::cout << "iterations: " << iterations << ", hardware threads: " << std::thread::hardware_concurrency() << std::endl;
+
+    bench_backend<CondvarBackend>(iterations);
+    bench_backend<FutexBackend>(iterations);
+    bench_backend<SpinBackend>(iterations);
+}
\ No newline at end of file
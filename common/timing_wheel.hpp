@@ -0,0 +1,290 @@
+#include <queue>
+#include <tuple>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+// Hierarchical timing wheel keyed on a non-negative integer tick, a drop-in replacement for a
+// min priority queue whose pops are (mostly) in time order, as in a simulator clock.
+//
+// Level k has 256 slots, one for each value of the k-th byte of the tick. An item sits on the
+// highest level where its tick differs from the wheel's current time, so push is O(1). When the
+// lower levels run dry, the next slot of a higher level is cascaded down; every item moves at
+// most once per level, so top/pop are O(1) amortized. Items with the same tick come out in the
+// order they were pushed. A push before the current time (the wheel looked ahead past it) goes
+// to a small heap that is always drained first.
+template <typename T>
+class TimingWheel
+{
+public:
+    static constexpr int slot_bits = 8;
+    static constexpr int slot_num = 1 << slot_bits;
+    static constexpr int level_num = 64 / slot_bits;
+
+    TimingWheel()
+    {
+        clear();
+    }
+
+    void reserve(size_t item_num)
+    {
+        nodes.reserve(item_num);
+    }
+
+    bool empty() const
+    {
+        return count == 0;
+    }
+
+    size_t size() const
+    {
+        return count;
+    }
+
+    void push(int64_t tick, T value)
+    {
+        if (tick < 0)
+        {
+            throw std::invalid_argument{"Negative tick!"};
+        }
+        uint32_t node = allocate(tick, std::move(value));
+        count++;
+        if ((uint64_t)tick < now)
+        {
+            early.emplace(tick, sequence++, node);
+            return;
+        }
+        link(node);
+    }
+
+    // the earliest item, the wheel must not be empty
+    const T &top()
+    {
+        return nodes[front()].value;
+    }
+
+    int64_t top_tick()
+    {
+        return nodes[front()].tick;
+    }
+
+    void pop()
+    {
+        uint32_t node = front();
+        if (!early.empty())
+        {
+            early.pop();
+        }
+        else
+        {
+            Slot &slot = slots[0][digit(now, 0)];
+            slot.head = nodes[node].next;
+            if (slot.head == nil)
+            {
+                slot.tail = nil;
+                occupied[0][digit(now, 0) / 64] &= ~(1ull << (digit(now, 0) % 64));
+            }
+        }
+        release(node);
+        count--;
+    }
+
+    // every pending item with its tick, in the order pop() would return them; pushing them back
+    // into an empty wheel in this order gives the same pops (used by checkpoints)
+    std::vector<std::pair<int64_t, T>> items() const
+    {
+        std::vector<std::pair<int64_t, T>> all;
+        all.reserve(count);
+        early_queue early_copy = early;
+        while (!early_copy.empty())
+        {
+            const Node &node = nodes[std::get<2>(early_copy.top())];
+            all.emplace_back(node.tick, node.value);
+            early_copy.pop();
+        }
+        // items of the same tick share a slot, in push order
+        size_t early_num = all.size();
+        for (auto &level : slots)
+        {
+            for (const Slot &slot : level)
+            {
+                for (uint32_t node = slot.head; node != nil; node = nodes[node].next)
+                {
+                    all.emplace_back(nodes[node].tick, nodes[node].value);
+                }
+            }
+        }
+        std::stable_sort(all.begin() + early_num, all.end(), [](auto &a, auto &b) { return a.first < b.first; });
+        return all;
+    }
+
+    void clear()
+    {
+        for (auto &level : slots)
+        {
+            for (Slot &slot : level)
+            {
+                slot = Slot{};
+            }
+        }
+        for (auto &level : occupied)
+        {
+            for (uint64_t &word : level)
+            {
+                word = 0;
+            }
+        }
+        nodes.clear();
+        free_list = nil;
+        early = early_queue{};
+        now = 0;
+        count = 0;
+        sequence = 0;
+    }
+
+private:
+    static constexpr uint32_t nil = UINT32_MAX;
+
+    struct Node
+    {
+        int64_t tick;
+        T value;
+        uint32_t next;
+    };
+
+    struct Slot
+    {
+        uint32_t head = nil;
+        uint32_t tail = nil;
+    };
+
+    using early_item = std::tuple<int64_t, uint64_t, uint32_t>; // (tick, push order, node)
+    using early_queue = std::priority_queue<early_item, std::vector<early_item>, std::greater<early_item>>;
+
+    static int digit(uint64_t tick, int level)
+    {
+        return (tick >> (level * slot_bits)) & (slot_num - 1);
+    }
+
+    uint32_t allocate(int64_t tick, T value)
+    {
+        if (free_list != nil)
+        {
+            uint32_t node = free_list;
+            free_list = nodes[node].next;
+            nodes[node].tick = tick;
+            nodes[node].value = std::move(value);
+            nodes[node].next = nil;
+            return node;
+        }
+        nodes.push_back(Node{tick, std::move(value), nil});
+        return nodes.size() - 1;
+    }
+
+    void release(uint32_t node)
+    {
+        nodes[node].next = free_list;
+        free_list = node;
+    }
+
+    // append to the slot of the highest byte in which the tick differs from now
+    void link(uint32_t node)
+    {
+        uint64_t diff = (uint64_t)nodes[node].tick ^ now;
+        int level = diff == 0 ? 0 : (63 - __builtin_clzll(diff)) / slot_bits;
+        int index = digit(nodes[node].tick, level);
+        Slot &slot = slots[level][index];
+        nodes[node].next = nil;
+        if (slot.tail == nil)
+        {
+            slot.head = node;
+            occupied[level][index / 64] |= 1ull << (index % 64);
+        }
+        else
+        {
+            nodes[slot.tail].next = node;
+        }
+        slot.tail = node;
+    }
+
+    // the first occupied slot of the level at or after `from`, -1 if none
+    int next_occupied(int level, int from) const
+    {
+        for (int word = from / 64; word < slot_num / 64; ++word)
+        {
+            uint64_t bits = occupied[level][word];
+            if (word == from / 64)
+            {
+                bits &= ~0ull << (from % 64);
+            }
+            if (bits != 0)
+            {
+                return word * 64 + __builtin_ctzll(bits);
+            }
+        }
+        return -1;
+    }
+
+    // the node of the earliest item, moves now forward to its slot
+    uint32_t front()
+    {
+        if (!early.empty())
+        {
+            return std::get<2>(early.top());
+        }
+        while (true)
+        {
+            int index = next_occupied(0, digit(now, 0));
+            if (index >= 0)
+            {
+                now = (now & ~(uint64_t)(slot_num - 1)) | index;
+                return slots[0][index].head;
+            }
+
+            // level 0 is used up, cascade the next slot of the lowest non-empty level
+            int level = 1;
+            for (; level < level_num; ++level)
+            {
+                index = next_occupied(level, digit(now, level));
+                if (index >= 0)
+                {
+                    break;
+                }
+            }
+            if (level == level_num)
+            {
+                throw std::out_of_range{"The timing wheel is empty!"};
+            }
+            int shift = level * slot_bits;
+            uint64_t high = shift + slot_bits >= 64 ? 0 : now >> (shift + slot_bits) << (shift + slot_bits);
+            now = high | (uint64_t)index << shift;
+
+            Slot slot = slots[level][index];
+            slots[level][index] = Slot{};
+            occupied[level][index / 64] &= ~(1ull << (index % 64));
+            for (uint32_t node = slot.head; node != nil;)
+            {
+                uint32_t next = nodes[node].next;
+                link(node);
+                node = next;
+            }
+        }
+    }
+
+    Slot slots[level_num][slot_num];
+    uint64_t occupied[level_num][slot_num / 64];
+    std::vector<Node> nodes;
+    uint32_t free_list;
+    early_queue early;
+    uint64_t now; // no item in the wheel (outside early) is before now
+    size_t count;
+    uint64_t sequence;
+};
+
+#endif // !TIMING_WHEEL_HPP
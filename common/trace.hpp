@@ -0,0 +1,208 @@
+#include <mutex>
+#include <deque>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <charconv>
+#include <cstdint>
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+namespace tracing
+{
+
+// Records timeline events in memory and writes them once in the Chrome trace-event JSON
+// format, which chrome://tracing and ui.perfetto.dev open directly. A record is a fixed-size
+// struct whose name points to a string literal or an interned string, so recording costs
+// one vector append and nothing is formatted until flush().
+class TraceRecorder
+{
+public:
+    TraceRecorder(const TraceRecorder &) = delete;
+    TraceRecorder &operator=(const TraceRecorder &) = delete;
+
+    // time stamps are given in the simulator's time unit, us_per_unit converts them to microseconds
+    explicit TraceRecorder(int64_t us_per_unit = 1) : us_per_unit(us_per_unit) {}
+
+    void reserve(size_t event_num)
+    {
+        records.reserve(event_num);
+    }
+
+    // a copy of the name that lives as long as the recorder
+    const char *intern(const std::string &name)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        names.push_back(name);
+        return names.back().c_str();
+    }
+
+    // the label of a lane (a process/thread pair in the viewer)
+    void set_lane_name(int pid, int tid, const char *name)
+    {
+        add({'M', pid, tid, 0, 0, name, -1, nullptr, 0});
+    }
+
+    // a segment [begin, end) on a lane; name_id >= 0 is appended to the name
+    void complete(int pid, int tid, int64_t begin, int64_t end, const char *name, int name_id = -1, const char *arg_name = nullptr, int arg = 0)
+    {
+        add({'X', pid, tid, begin, end - begin, name, name_id, arg_name, arg});
+    }
+
+    // a point in time on a lane
+    void instant(int pid, int tid, int64_t time, const char *name, int name_id = -1, const char *arg_name = nullptr, int arg = 0)
+    {
+        add({'i', pid, tid, time, 0, name, name_id, arg_name, arg});
+    }
+
+    size_t size() const
+    {
+        return records.size();
+    }
+
+    // drop the recorded events, the interned names stay valid
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        records.clear();
+    }
+
+    bool flush(const std::string &file_name) const
+    {
+        std::ofstream out(file_name);
+        if (!out)
+        {
+            return false;
+        }
+        write(out);
+        return (bool)out;
+    }
+
+    // events are formatted into a fixed buffer and streamed out in large chunks
+    void write(std::ostream &out) const
+    {
+        constexpr size_t buffer_size = 1 << 16;
+        constexpr size_t max_name_size = 256;
+        std::unique_ptr<char[]> buffer(new char[buffer_size]);
+        char *p = buffer.get();
+        char *end = p + buffer_size;
+
+        auto put = [&p](const char *s) {
+            while (*s)
+            {
+                *p++ = *s++;
+            }
+        };
+        auto put_int = [&p, end](int64_t value) {
+            p = std::to_chars(p, end, value).ptr;
+        };
+
+        put("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const Record &r : records)
+        {
+            if (end - p < (ptrdiff_t)(max_name_size + 256))
+            {
+                out.write(buffer.get(), p - buffer.get());
+                p = buffer.get();
+            }
+            if (!first)
+            {
+                put(",\n");
+            }
+            first = false;
+
+            if (r.phase == 'M')
+            {
+                put("{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":");
+                put_int(r.pid);
+                put(",\"tid\":");
+                put_int(r.tid);
+                put(",\"args\":{\"name\":\"");
+                put_name(p, r.name, max_name_size);
+                put("\"}}");
+                continue;
+            }
+
+            put("{\"ph\":\"");
+            *p++ = r.phase;
+            put("\",\"name\":\"");
+            put_name(p, r.name, max_name_size);
+            if (r.name_id >= 0)
+            {
+                put_int(r.name_id);
+            }
+            put("\",\"pid\":");
+            put_int(r.pid);
+            put(",\"tid\":");
+            put_int(r.tid);
+            put(",\"ts\":");
+            put_int(r.time * us_per_unit);
+            if (r.phase == 'X')
+            {
+                put(",\"dur\":");
+                put_int(r.duration * us_per_unit);
+            }
+            else
+            {
+                put(",\"s\":\"t\"");
+            }
+            if (r.arg_name != nullptr)
+            {
+                put(",\"args\":{\"");
+                put_name(p, r.arg_name, max_name_size);
+                put("\":");
+                put_int(r.arg);
+                put("}");
+            }
+            put("}");
+        }
+        put("\n]}\n");
+        out.write(buffer.get(), p - buffer.get());
+    }
+
+private:
+    struct Record
+    {
+        char phase; // 'X' complete, 'i' instant, 'M' lane name
+        int pid;
+        int tid;
+        int64_t time;
+        int64_t duration;
+        const char *name;
+        int name_id;
+        const char *arg_name;
+        int arg;
+    };
+
+    void add(const Record &record)
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        records.push_back(record);
+    }
+
+    // copy a name, escaping the characters JSON does not allow in a string
+    static void put_name(char *&p, const char *name, size_t max_size)
+    {
+        for (size_t i = 0; name[i] && i < max_size / 2; ++i)
+        {
+            char c = name[i];
+            if (c == '"' || c == '\\')
+            {
+                *p++ = '\\';
+            }
+            *p++ = (unsigned char)c < 0x20 ? ' ' : c;
+        }
+    }
+
+    int64_t us_per_unit;
+    std::mutex mtx; // the threaded bank records from many threads
+    std::vector<Record> records;
+    std::deque<std::string> names;
+};
+
+} // namespace tracing
+
+#endif // !TRACE_HPP
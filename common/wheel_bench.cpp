@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <queue>
+#include <functional>
+#include "timing_wheel.hpp"
+
+// compare the timing wheel with a binary heap as the pending-release queue of a simulator
+//
+// usage: ./wheel_bench [max_pending_exponent]    (6..8, default 7: 10^6 and 10^7 pending releases)
+
+static double measure_ns(long operations, const std::function<void()> &body)
+{
+    auto begin = std::chrono::steady_clock::now();
+    body();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - begin).count() / operations;
+}
+
+static void report(const char *queue, const char *test, long pending, double ns_per_op)
+{
+    std::cout << std::left << std::setw(8) << queue << std::setw(22) << test << std::setw(12) << pending
+              << std::right << std::fixed << std::setprecision(1) << std::setw(10) << ns_per_op << " ns/op" << std::endl;
+}
+
+// the heap with the interface of the wheel, ties broken by push order like the wheel does
+class HeapQueue
+{
+public:
+    void push(int64_t tick, int value)
+    {
+        heap.emplace(tick, sequence++, value);
+    }
+
+    int64_t top_tick() const
+    {
+        return std::get<0>(heap.top());
+    }
+
+    int top() const
+    {
+        return std::get<2>(heap.top());
+    }
+
+    void pop()
+    {
+        heap.pop();
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+private:
+    using item = std::tuple<int64_t, uint64_t, int>;
+    std::priority_queue<item, std::vector<item>, std::greater<item>> heap;
+    uint64_t sequence = 0;
+};
+
+template <typename Queue>
+void bench_queue(const char *name, long pending, const std::vector<int64_t> &ticks, const std::vector<int64_t> &steps)
+{
+    long checksum = 0;
+
+    // all releases known up front, then expired in order (the lab4 arrival queue)
+    {
+        Queue queue;
+        double ns = measure_ns(pending, [&] {
+            for (long i = 0; i < pending; ++i)
+            {
+                queue.push(ticks[i], i);
+            }
+        });
+        report(name, "bulk insert", pending, ns);
+
+        int64_t last = 0;
+        ns = measure_ns(pending, [&] {
+            while (!queue.empty())
+            {
+                int64_t tick = queue.top_tick();
+                if (tick < last)
+                {
+                    std::cout << "out of order!" << std::endl;
+                }
+                last = tick;
+                checksum += queue.top();
+                queue.pop();
+            }
+        });
+        report(name, "expire in order", pending, ns);
+    }
+
+    // hold model: a fixed number of pending timers, each expiry schedules a new one later
+    {
+        Queue queue;
+        for (long i = 0; i < pending; ++i)
+        {
+            queue.push(ticks[i], i);
+        }
+        long operations = std::min<long>(pending, 10000000);
+        double ns = measure_ns(operations, [&] {
+            for (long i = 0; i < operations; ++i)
+            {
+                int64_t tick = queue.top_tick();
+                int value = queue.top();
+                queue.pop();
+                queue.push(tick + steps[i % steps.size()], value);
+            }
+        });
+        report(name, "hold (pop + push)", pending, ns);
+    }
+
+    if (checksum == -1)
+    {
+        std::cout << checksum << std::endl;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int max_exponent = 7;
+    if (argc > 1)
+    {
+        max_exponent = std::stoi(argv[1]);
+    }
+
+    std::mt19937_64 rng(2023);
+    for (int exponent = 6; exponent <= max_exponent; ++exponent)
+    {
+        long pending = 1;
+        for (int i = 0; i < exponent; ++i)
+        {
+            pending *= 10;
+        }
+        // releases spread over 100 ticks per pending item, delays like periods of a task set
+        std::uniform_int_distribution<int64_t> tick_dist(0, pending * 100);
+        std::uniform_int_distribution<int64_t> step_dist(1, pending * 100);
+        std::vector<int64_t> ticks(pending);
+        for (auto &tick : ticks)
+        {
+            tick = tick_dist(rng);
+        }
+        std::vector<int64_t> steps(1 << 20);
+        for (auto &step : steps)
+        {
+            step = step_dist(rng);
+        }
+
+        bench_queue<HeapQueue>("heap", pending, ticks, steps);
+        bench_queue<TimingWheel<int>>("wheel", pending, ticks, steps);
+    }
+}
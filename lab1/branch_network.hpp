@@ -0,0 +1,175 @@
+#include <vector>
+#include <memory>
+#include <thread>
+#include <climits>
+#include <stdexcept>
+#include "engine.hpp"
+
+#ifndef BRANCH_NETWORK_HPP
+#define BRANCH_NETWORK_HPP
+
+// A customer handed from one branch to another, it arrives at the target after the transfer delay.
+struct Transfer
+{
+    int target;
+    int arrive_time;
+    int service_time;
+    int priority;
+};
+
+// Several banks (branches), each one a virtual-time Engine. A customer who finds too many
+// people waiting at a branch walks to the next branch and arrives there transfer_delay later.
+//
+// The branches are simulated in parallel with conservative time windows: no transfer can
+// arrive sooner than transfer_delay after it is sent, so every branch can advance through
+// [start, start + transfer_delay) without hearing from the others. After each window the
+// transfers are delivered in branch order, which keeps the result independent of the number
+// of threads.
+class BranchNetwork
+{
+    BranchNetwork(const BranchNetwork &) = delete;
+    BranchNetwork &operator=(const BranchNetwork &) = delete;
+
+public:
+    // customer i of the list goes to branch i % branch_num
+    BranchNetwork(int branch_num, int server_num, const std::vector<Customer> &customers, int transfer_threshold, int transfer_delay, dispatch_policy policy = dispatch_policy::SHARED, queue_discipline discipline = queue_discipline::FIFO) : transfer_delay(transfer_delay), outboxes(branch_num), next_time(branch_num)
+    {
+        if (branch_num <= 0 || transfer_delay <= 0)
+        {
+            throw std::invalid_argument{"Invalid argument!"};
+        }
+
+        std::vector<std::vector<Customer>> split(branch_num);
+        for (size_t i = 0; i < customers.size(); ++i)
+        {
+            const Customer &c = customers[i];
+            std::vector<Customer> &local = split[i % branch_num];
+            local.push_back(Customer(local.size(), c.get_start_time(), c.get_service_time(), c.get_priority()));
+        }
+
+        branches.reserve(branch_num);
+        for (int b = 0; b < branch_num; ++b)
+        {
+            branches.push_back(std::make_unique<Engine>(server_num, split[b], policy, discipline));
+            int target = (b + 1) % branch_num;
+            branches[b]->set_overflow(branch_num > 1 ? transfer_threshold : -1, [this, b, target](const Customer &c, int now) {
+                outboxes[b].push_back({target, now + this->transfer_delay, c.get_service_time(), c.get_priority()});
+            });
+        }
+    }
+
+    void run(int thread_num)
+    {
+        if (thread_num <= 0)
+        {
+            throw std::invalid_argument{"Invalid argument!"};
+        }
+        thread_num = std::min(thread_num, (int)branches.size());
+
+        for (auto &branch : branches)
+        {
+            branch->begin_simulation();
+        }
+        for (size_t b = 0; b < branches.size(); ++b)
+        {
+            next_time[b] = branches[b]->next_event_time();
+        }
+        window_num = 0;
+        transfer_num = 0;
+
+        primitives::Barrier<> barrier(thread_num);
+        std::vector<std::thread> workers;
+        for (int t = 1; t < thread_num; ++t)
+        {
+            workers.emplace_back(&BranchNetwork::run_worker, this, t, thread_num, std::ref(barrier));
+        }
+        run_worker(0, thread_num, barrier);
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    int get_branch_num() const
+    {
+        return branches.size();
+    }
+
+    const Engine &get_branch(int b) const
+    {
+        return *branches[b];
+    }
+
+    long long get_window_num() const
+    {
+        return window_num;
+    }
+
+    long long get_transfer_num() const
+    {
+        return transfer_num;
+    }
+
+private:
+    // thread t owns the branches b with b % thread_num == t
+    void run_worker(int t, int thread_num, primitives::Barrier<> &barrier)
+    {
+        int branch_num = branches.size();
+        while (true)
+        {
+            // every thread computes the same window from the same next_time array
+            int start = INT_MAX;
+            for (int b = 0; b < branch_num; ++b)
+            {
+                start = std::min(start, next_time[b]);
+            }
+            if (start == INT_MAX)
+            {
+                break;
+            }
+            int end = start > INT_MAX - transfer_delay ? INT_MAX : start + transfer_delay;
+
+            // the outboxes were all read before the last barrier
+            for (int b = t; b < branch_num; b += thread_num)
+            {
+                outboxes[b].clear();
+                branches[b]->advance_until(end);
+            }
+            barrier.ArriveAndWait();
+
+            // deliver the transfers of this window in source branch order
+            for (int d = t; d < branch_num; d += thread_num)
+            {
+                for (int s = 0; s < branch_num; ++s)
+                {
+                    for (const Transfer &transfer : outboxes[s])
+                    {
+                        if (transfer.target == d)
+                        {
+                            branches[d]->inject(transfer.arrive_time, transfer.service_time, transfer.priority);
+                        }
+                    }
+                }
+                next_time[d] = branches[d]->next_event_time();
+            }
+            if (t == 0)
+            {
+                window_num++;
+                for (int s = 0; s < branch_num; ++s)
+                {
+                    transfer_num += outboxes[s].size();
+                }
+            }
+            barrier.ArriveAndWait();
+        }
+    }
+
+    int transfer_delay; // also the lookahead of the windows
+    std::vector<std::unique_ptr<Engine>> branches;
+    std::vector<std::vector<Transfer>> outboxes; // transfers sent by each branch in the current window
+    std::vector<int> next_time; // earliest pending event of each branch
+    long long window_num = 0;
+    long long transfer_num = 0;
+};
+
+#endif // !BRANCH_NETWORK_HPP
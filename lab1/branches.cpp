@@ -0,0 +1,107 @@
+#include <iostream>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+
+#include "branch_network.hpp"
+
+// served customers, customers that left for another branch, and the mean wait of the served ones
+void print_summary(const BranchNetwork &network)
+{
+    long long served = 0;
+    long long transferred = 0;
+    long long total_wait = 0;
+    for (int b = 0; b < network.get_branch_num(); ++b)
+    {
+        const ResultTable &results = network.get_branch(b).get_results();
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            if (results.load(i, SERVE_ID) < 0)
+            {
+                transferred++;
+                continue;
+            }
+            served++;
+            total_wait += results.load(i, BEGIN_SERVE) - results.load(i, IN_BANK);
+        }
+    }
+    std::cout << "Served " << served << " customers, " << transferred << " transfers, mean wait " << (served ? (double)total_wait / served : 0.0)
+              << ", " << network.get_window_num() << " windows" << std::endl;
+}
+
+// whether two runs of the same network produced the same results
+bool same_results(const BranchNetwork &a, const BranchNetwork &b)
+{
+    for (int branch = 0; branch < a.get_branch_num(); ++branch)
+    {
+        const ResultTable &x = a.get_branch(branch).get_results();
+        const ResultTable &y = b.get_branch(branch).get_results();
+        if (x.size() != y.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < x.size(); ++i)
+        {
+            for (int column = 0; column < ResultTable::column_num; ++column)
+            {
+                if (x.load(i, column) != y.load(i, column))
+                {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    // ./branches [branches] [servers_per_branch] [threads] [transfer_threshold] [transfer_delay] [policy] [discipline] [verify]
+    int branch_num = argc > 1 ? std::stoi(argv[1]) : 4;
+    int server_num = argc > 2 ? std::stoi(argv[2]) : 2;
+    int thread_num = argc > 3 ? std::stoi(argv[3]) : 4;
+    int transfer_threshold = argc > 4 ? std::stoi(argv[4]) : 3;
+    int transfer_delay = argc > 5 ? std::stoi(argv[5]) : 1;
+    dispatch_policy policy = argc > 6 ? parse_dispatch_policy(argv[6]) : dispatch_policy::SHARED;
+    queue_discipline discipline = argc > 7 ? parse_queue_discipline(argv[7]) : queue_discipline::FIFO;
+    bool verify = argc > 8 && std::string(argv[8]) == "verify";
+    std::cout << branch_num << " branches, " << server_num << " servers each, " << thread_num << " threads, transfer threshold " << transfer_threshold
+              << ", transfer delay " << transfer_delay << std::endl;
+
+    // same input as main: index, arrival time, service time, optional priority
+    std::vector<Customer> customers;
+    std::ifstream infile("test.txt");
+    std::string line;
+    while (std::getline(infile, line))
+    {
+        std::istringstream fields(line);
+        int a, b, c, d = 0;
+        if (!(fields >> a >> b >> c))
+        {
+            continue;
+        }
+        fields >> d;
+        customers.push_back(Customer(customers.size(), b, c, d));
+    }
+
+    BranchNetwork network(branch_num, server_num, customers, transfer_threshold, transfer_delay, policy, discipline);
+    auto begin = std::chrono::steady_clock::now();
+    network.run(thread_num);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    print_summary(network);
+    std::cout << "Wall time " << seconds << " s, " << (seconds > 0 ? customers.size() / seconds : 0.0) << " customers/s" << std::endl;
+
+    if (verify)
+    {
+        // the windows make the result independent of the thread count
+        BranchNetwork sequential(branch_num, server_num, customers, transfer_threshold, transfer_delay, policy, discipline);
+        begin = std::chrono::steady_clock::now();
+        sequential.run(1);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+        std::cout << "Sequential wall time " << seconds << " s, results " << (same_results(network, sequential) ? "identical" : "DIFFERENT") << std::endl;
+        return same_results(network, sequential) ? 0 : 1;
+    }
+    return 0;
+}
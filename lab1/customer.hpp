@@ -1,22 +1,21 @@
-#include "semaphore.hpp"
+#include <iostream>
+#include <atomic>
+#include <type_traits>
 
 #ifndef CUSTOMER_HPP
 #define CUSTOMER_HPP
 
+// A customer is a plain 20-byte record. Completion is a single int flag that the
+// customer thread blocks on with std::atomic_ref::wait, so no mutex or condition
+// variable is carried per customer and millions of them fit in cache-friendly arrays.
 class Customer
 {
 public:
-    Customer &operator=(const Customer &) = delete;
-    ~Customer() = default;
+    Customer() = default;
 
-    Customer(int index, int start_time, int service_time): index(index), start_time(start_time), service_time(service_time), sem(0, 1)
+    Customer(int index, int start_time, int service_time, int priority = 0): index(index), start_time(start_time), service_time(service_time), priority(priority), served(0)
     {
-        
-    }
 
-    Customer(const Customer &customer): index(customer.index), start_time(customer.start_time), service_time(customer.service_time), sem(customer.sem)
-    {
-        
     }
 
     void print_info()
@@ -24,16 +23,26 @@ public:
         std::cout << "Customer " << index << " start at " << start_time << ", service time " << service_time << std::endl;
     }
 
+    // mark the service as finished and wake the waiting customer thread
     void up()
     {
-        sem.Up();  
+        std::atomic_ref<int> flag(served);
+        flag.store(1, std::memory_order_release);
+        flag.notify_one();
     };
 
+    // block until the service is finished
     void down()
     {
-        sem.Down();
+        std::atomic_ref<int> flag(served);
+        flag.wait(0, std::memory_order_acquire);
     };
 
+    bool is_served() const noexcept
+    {
+        return std::atomic_ref<int>(const_cast<int &>(served)).load(std::memory_order_acquire) != 0;
+    }
+
     // get functions, not changeable
     const int get_index() const noexcept
     {
@@ -50,11 +59,21 @@ public:
         return service_time;
     }
 
+    // priority class, 0 is the most urgent
+    const int get_priority() const noexcept
+    {
+        return priority;
+    }
+
 private:
     int index;
     int start_time;
     int service_time;
-    Semaphore sem;
+    int priority;
+    alignas(std::atomic_ref<int>::required_alignment) int served; // 0 while waiting, 1 once served
 };
 
+static_assert(std::is_trivially_copyable<Customer>::value, "Customer must stay a plain record");
+static_assert(sizeof(Customer) == 20, "Customer must stay compact");
+
 #endif // CUSTOMER_HPP
\ No newline at end of file
@@ -0,0 +1,227 @@
+#include <vector>
+#include <string>
+#include <utility>
+#include <stdexcept>
+#include "customer.hpp"
+#include "../common/snapshot.hpp"
+
+#ifndef CUSTOMER_QUEUE_HPP
+#define CUSTOMER_QUEUE_HPP
+
+enum class queue_discipline
+{
+    FIFO,
+    SJF, // shortest service time first
+    PRIORITY, // lowest priority class first, FIFO inside a class
+    SRPT // shortest remaining service time first, preemptive-resume
+};
+
+inline queue_discipline parse_queue_discipline(const std::string &name)
+{
+    if (name == "fifo") return queue_discipline::FIFO;
+    if (name == "sjf") return queue_discipline::SJF;
+    if (name == "priority") return queue_discipline::PRIORITY;
+    if (name == "srpt") return queue_discipline::SRPT;
+    throw std::invalid_argument{"Unknown queue discipline: " + name};
+}
+
+inline const char *queue_discipline_name(queue_discipline discipline)
+{
+    switch (discipline)
+    {
+        case queue_discipline::FIFO: return "fifo";
+        case queue_discipline::SJF: return "sjf";
+        case queue_discipline::PRIORITY: return "priority";
+        case queue_discipline::SRPT: return "srpt";
+    }
+    return "unknown";
+}
+
+// Per-customer queueing state, indexed by customer index and shared by every queue of an
+// engine (a customer waits in at most one queue at a time).
+struct QueueIndex
+{
+    std::vector<int> position; // slot in the heap holding the customer, -1 when not queued
+    std::vector<int> remaining; // service still owed, shrinks when SRPT preempts
+    std::vector<long long> sequence; // order of (re)entering a queue, breaks ties FIFO
+
+    // customers are added in index order
+    void add(const Customer &customer)
+    {
+        position.push_back(-1);
+        remaining.push_back(customer.get_service_time());
+        sequence.push_back(0);
+    }
+};
+
+// Indexed binary heap of waiting customers ordered by the discipline. The position of
+// every customer is tracked, so top/pop/push are O(log n) and a queued customer can be
+// erased or re-keyed in O(log n) as well.
+class CustomerQueue
+{
+public:
+    CustomerQueue() = default;
+
+    void init(queue_discipline new_discipline, QueueIndex *new_index)
+    {
+        discipline = new_discipline;
+        index = new_index;
+    }
+
+    bool empty() const
+    {
+        return heap.empty();
+    }
+
+    size_t size() const
+    {
+        return heap.size();
+    }
+
+    Customer *top() const
+    {
+        return heap.front();
+    }
+
+    void push(Customer *customer)
+    {
+        index->sequence[customer->get_index()] = next_sequence++;
+        heap.push_back(customer);
+        index->position[customer->get_index()] = heap.size() - 1;
+        sift_up(heap.size() - 1);
+    }
+
+    Customer *pop()
+    {
+        Customer *customer = heap.front();
+        erase(customer);
+        return customer;
+    }
+
+    void erase(Customer *customer)
+    {
+        int slot = index->position[customer->get_index()];
+        index->position[customer->get_index()] = -1;
+        Customer *last = heap.back();
+        heap.pop_back();
+        if (slot < (int)heap.size())
+        {
+            place(slot, last);
+            update_at(slot);
+        }
+    }
+
+    // restore the order after the key of a queued customer changed
+    void update(Customer *customer)
+    {
+        update_at(index->position[customer->get_index()]);
+    }
+
+    // the heap key, smaller is served first
+    std::pair<int, long long> key(const Customer *customer) const
+    {
+        int i = customer->get_index();
+        switch (discipline)
+        {
+            case queue_discipline::FIFO: return {0, index->sequence[i]};
+            case queue_discipline::SJF: return {customer->get_service_time(), index->sequence[i]};
+            case queue_discipline::PRIORITY: return {customer->get_priority(), index->sequence[i]};
+            case queue_discipline::SRPT: return {index->remaining[i], index->sequence[i]};
+        }
+        return {0, index->sequence[i]};
+    }
+
+    // the heap as customer indices; customer(i) gives back the customer of index i
+    void save(snapshot::Writer &out) const
+    {
+        std::vector<int> indices;
+        indices.reserve(heap.size());
+        for (const Customer *customer : heap)
+        {
+            indices.push_back(customer->get_index());
+        }
+        out.put_vector(indices);
+        out.put(next_sequence);
+    }
+
+    template <typename Resolve>
+    void load(snapshot::Reader &in, Resolve customer)
+    {
+        std::vector<int> indices = in.get_vector<int>();
+        heap.resize(indices.size());
+        for (size_t slot = 0; slot < indices.size(); ++slot)
+        {
+            place(slot, customer(indices[slot]));
+        }
+        in.get(next_sequence);
+    }
+
+private:
+    void place(size_t slot, Customer *customer)
+    {
+        heap[slot] = customer;
+        index->position[customer->get_index()] = slot;
+    }
+
+    void update_at(size_t slot)
+    {
+        if (slot > 0 && key(heap[slot]) < key(heap[(slot - 1) / 2]))
+        {
+            sift_up(slot);
+        }
+        else
+        {
+            sift_down(slot);
+        }
+    }
+
+    void sift_up(size_t slot)
+    {
+        Customer *customer = heap[slot];
+        auto k = key(customer);
+        while (slot > 0)
+        {
+            size_t parent = (slot - 1) / 2;
+            if (!(k < key(heap[parent])))
+            {
+                break;
+            }
+            place(slot, heap[parent]);
+            slot = parent;
+        }
+        place(slot, customer);
+    }
+
+    void sift_down(size_t slot)
+    {
+        Customer *customer = heap[slot];
+        auto k = key(customer);
+        size_t n = heap.size();
+        while (true)
+        {
+            size_t child = 2 * slot + 1;
+            if (child >= n)
+            {
+                break;
+            }
+            if (child + 1 < n && key(heap[child + 1]) < key(heap[child]))
+            {
+                child++;
+            }
+            if (!(key(heap[child]) < k))
+            {
+                break;
+            }
+            place(slot, heap[child]);
+            slot = child;
+        }
+        place(slot, customer);
+    }
+
+    queue_discipline discipline = queue_discipline::FIFO;
+    QueueIndex *index = nullptr;
+    std::vector<Customer *> heap;
+    long long next_sequence = 0;
+};
+
+#endif // !CUSTOMER_QUEUE_HPP
@@ -0,0 +1,354 @@
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <stdexcept>
+#include "customer.hpp"
+#include "customer_queue.hpp"
+
+#ifndef DISPATCHER_HPP
+#define DISPATCHER_HPP
+
+enum class dispatch_policy
+{
+    SHARED, // one queue for all servers, the original topology
+    ROUND_ROBIN,
+    JOIN_SHORTEST_QUEUE,
+    POWER_OF_TWO, // the shorter of two randomly chosen servers
+    WORK_STEALING // round robin, idle servers take from the longest other queue
+};
+
+inline dispatch_policy parse_dispatch_policy(const std::string &name)
+{
+    if (name == "shared") return dispatch_policy::SHARED;
+    if (name == "rr") return dispatch_policy::ROUND_ROBIN;
+    if (name == "jsq") return dispatch_policy::JOIN_SHORTEST_QUEUE;
+    if (name == "p2c") return dispatch_policy::POWER_OF_TWO;
+    if (name == "steal") return dispatch_policy::WORK_STEALING;
+    throw std::invalid_argument{"Unknown dispatch policy: " + name};
+}
+
+inline const char *dispatch_policy_name(dispatch_policy policy)
+{
+    switch (policy)
+    {
+        case dispatch_policy::SHARED: return "shared";
+        case dispatch_policy::ROUND_ROBIN: return "rr";
+        case dispatch_policy::JOIN_SHORTEST_QUEUE: return "jsq";
+        case dispatch_policy::POWER_OF_TWO: return "p2c";
+        case dispatch_policy::WORK_STEALING: return "steal";
+    }
+    return "unknown";
+}
+
+// Routes arriving customers to per-server local queues, and hands the next customer to a
+// server that asks for work. Each queue sits on its own cache line with its own lock, so
+// servers only contend when the policy makes them share or steal work. Inside a queue the
+// customers are ordered by the queue discipline.
+class Dispatcher
+{
+    Dispatcher(const Dispatcher &) = delete;
+    Dispatcher &operator=(const Dispatcher &) = delete;
+
+public:
+    Dispatcher(int server_num, dispatch_policy policy, queue_discipline discipline) : policy(policy), discipline(discipline), queues(policy == dispatch_policy::SHARED ? 1 : server_num), server_num(server_num)
+    {
+        for (auto &q : queues)
+        {
+            q.customers.init(discipline, &index);
+        }
+    }
+
+    // every customer that may be routed is registered first, in index order
+    void add_customer(const Customer &customer)
+    {
+        index.add(customer);
+        started.push_back(0);
+    }
+
+    // a new customer takes the index of one that has left (Engine::retire)
+    void reuse_customer(const Customer &customer)
+    {
+        int i = customer.get_index();
+        index.position[i] = -1;
+        index.remaining[i] = customer.get_service_time();
+        index.sequence[i] = 0;
+        started[i] = 0;
+    }
+
+    // SRPT may take a customer away from its server when a shorter one is waiting
+    bool preemptive() const
+    {
+        return discipline == queue_discipline::SRPT;
+    }
+
+    // true when any server may serve any queued customer, so one shared wakeup counter is enough
+    bool shares_work() const
+    {
+        return policy == dispatch_policy::SHARED || policy == dispatch_policy::WORK_STEALING;
+    }
+
+    // enqueue the customer, returns the id of the server queue it was put in
+    int route(Customer *customer)
+    {
+        int target = choose_queue();
+        LocalQueue &q = queues[target];
+        {
+            std::unique_lock<std::mutex> lock(q.mtx);
+            q.customers.push(customer);
+        }
+        q.queued++;
+        q.load++;
+        pending_num++;
+        return target;
+    }
+
+    // whether a customer waiting for this server needs less service than `remaining`
+    bool should_preempt(int server_id, int remaining)
+    {
+        LocalQueue &q = queues[queue_of(server_id)];
+        if (q.queued.load() == 0)
+        {
+            return false;
+        }
+        std::unique_lock<std::mutex> lock(q.mtx);
+        return !q.customers.empty() && index.remaining[q.customers.top()->get_index()] < remaining;
+    }
+
+    // put a preempted customer back into the queue of its server, it still counts as that server's load
+    void requeue(int server_id, Customer *customer, int remaining)
+    {
+        LocalQueue &q = queues[queue_of(server_id)];
+        {
+            std::unique_lock<std::mutex> lock(q.mtx);
+            index.remaining[customer->get_index()] = remaining;
+            q.customers.push(customer);
+        }
+        q.queued++;
+        pending_num++;
+    }
+
+    // remaining service of the customer, its full service time unless it was preempted
+    int remaining(const Customer *customer) const
+    {
+        return index.remaining[customer->get_index()];
+    }
+
+    // the first call for a customer returns true, later (resumed) services return false
+    bool first_service(const Customer *customer)
+    {
+        char &flag = started[customer->get_index()];
+        if (flag)
+        {
+            return false;
+        }
+        flag = 1;
+        return true;
+    }
+
+    // the remaining service of the next customer in this server's queue, -1 if there is none
+    int peek_remaining(int server_id)
+    {
+        LocalQueue &q = queues[queue_of(server_id)];
+        std::unique_lock<std::mutex> lock(q.mtx);
+        return q.customers.empty() ? -1 : index.remaining[q.customers.top()->get_index()];
+    }
+
+    // the next customer for this server, or nullptr when there is nothing it may take
+    Customer *take(int server_id)
+    {
+        Customer *customer = pop(queue_of(server_id));
+        if (customer == nullptr && policy == dispatch_policy::WORK_STEALING)
+        {
+            int victim = longest_queue(server_id);
+            if (victim >= 0)
+            {
+                customer = pop(victim);
+                if (customer != nullptr)
+                {
+                    // the work now belongs to the thief
+                    queues[victim].load--;
+                    queues[server_id].load++;
+                }
+            }
+        }
+        return customer;
+    }
+
+    // the server finished a customer it took
+    void finish(int server_id)
+    {
+        queues[queue_of(server_id)].load--;
+    }
+
+    int pending() const
+    {
+        return pending_num.load();
+    }
+
+    dispatch_policy get_policy() const
+    {
+        return policy;
+    }
+
+    queue_discipline get_discipline() const
+    {
+        return discipline;
+    }
+
+    // what the dispatcher keeps of one customer besides its place in a queue
+    struct Progress
+    {
+        int remaining;
+        long long sequence;
+        char started;
+    };
+
+    Progress get_progress(int customer) const
+    {
+        return Progress{index.remaining[customer], index.sequence[customer], started[customer]};
+    }
+
+    void set_progress(int customer, const Progress &progress)
+    {
+        index.remaining[customer] = progress.remaining;
+        index.sequence[customer] = progress.sequence;
+        started[customer] = progress.started;
+    }
+
+    // the queues for a checkpoint of the virtual mode, with the random engine that
+    // power-of-two routing draws from; the per-customer state is saved by the engine
+    void save(snapshot::Writer &out) const
+    {
+        for (const LocalQueue &q : queues)
+        {
+            q.customers.save(out);
+            out.put(q.queued.load());
+            out.put(q.load.load());
+        }
+        out.put(next_server.load());
+        out.put(pending_num.load());
+        std::unique_lock<std::mutex> lock(rng_mtx);
+        out.put(rng);
+    }
+
+    template <typename Resolve>
+    void load(snapshot::Reader &in, Resolve customer)
+    {
+        std::fill(index.position.begin(), index.position.end(), -1);
+        for (LocalQueue &q : queues)
+        {
+            q.customers.load(in, customer);
+            q.queued = in.get<int>();
+            q.load = in.get<int>();
+        }
+        next_server = in.get<int>();
+        pending_num = in.get<int>();
+        std::unique_lock<std::mutex> lock(rng_mtx);
+        in.get(rng);
+    }
+
+private:
+    struct alignas(64) LocalQueue
+    {
+        std::mutex mtx;
+        CustomerQueue customers;
+        std::atomic<int> queued{0}; // waiting in this queue
+        std::atomic<int> load{0}; // waiting plus in service, what JSQ compares
+    };
+
+    int queue_of(int server_id) const
+    {
+        return policy == dispatch_policy::SHARED ? 0 : server_id;
+    }
+
+    int choose_queue()
+    {
+        switch (policy)
+        {
+            case dispatch_policy::SHARED:
+                return 0;
+            case dispatch_policy::ROUND_ROBIN:
+            case dispatch_policy::WORK_STEALING:
+                return next_server.fetch_add(1) % server_num;
+            case dispatch_policy::JOIN_SHORTEST_QUEUE:
+            {
+                int best = 0;
+                for (int i = 1; i < server_num; ++i)
+                {
+                    if (queues[i].load.load() < queues[best].load.load())
+                    {
+                        best = i;
+                    }
+                }
+                return best;
+            }
+            case dispatch_policy::POWER_OF_TWO:
+            {
+                // one engine for every customer thread: each routes once, so an engine per
+                // thread would give every customer the same two candidates
+                int a, b;
+                {
+                    std::unique_lock<std::mutex> lock(rng_mtx);
+                    a = rng() % server_num;
+                    b = rng() % server_num;
+                }
+                return queues[b].load.load() < queues[a].load.load() ? b : a;
+            }
+        }
+        return 0;
+    }
+
+    Customer *pop(int queue_id)
+    {
+        LocalQueue &q = queues[queue_id];
+        if (q.queued.load() == 0)
+        {
+            return nullptr;
+        }
+        Customer *customer = nullptr;
+        {
+            std::unique_lock<std::mutex> lock(q.mtx);
+            if (q.customers.empty())
+            {
+                return nullptr;
+            }
+            customer = q.customers.pop();
+        }
+        q.queued--;
+        pending_num--;
+        return customer;
+    }
+
+    int longest_queue(int except)
+    {
+        int victim = -1;
+        int longest = 0;
+        for (int i = 0; i < server_num; ++i)
+        {
+            int length = queues[i].queued.load();
+            if (i != except && length > longest)
+            {
+                victim = i;
+                longest = length;
+            }
+        }
+        return victim;
+    }
+
+    dispatch_policy policy;
+    queue_discipline discipline;
+    QueueIndex index;
+    std::vector<char> started; // whether the customer has begun its first service
+    std::vector<LocalQueue> queues;
+    int server_num;
+    alignas(64) std::atomic<int> next_server{0};
+    alignas(64) std::atomic<int> pending_num{0};
+    mutable std::mutex rng_mtx; // customer threads route concurrently
+    std::minstd_rand rng{2023};
+};
+
+#endif // !DISPATCHER_HPP
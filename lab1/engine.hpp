@@ -8,8 +8,26 @@
 #include <iomanip>
 #include <cmath>
 #include <algorithm>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <numeric>
+#include <set>
+#include <tuple>
+#include <deque>
+#include <climits>
+#include <cerrno>
+#include <stdexcept>
+#include <time.h>
 #include "customer.hpp"
+#include "result_table.hpp"
+#include "dispatcher.hpp"
 #include "semaphore.hpp"
+#include "../common/trace.hpp"
+#include "../common/timing_wheel.hpp"
+#include "../common/snapshot.hpp"
 
 #ifndef ENGINE_HPP
 #define ENGINE_HPP
@@ -28,7 +46,69 @@ class Engine
     Engine &operator=(const Engine &) = delete;
 
 public:
-    Engine(int server_num, std::vector<Customer> customers): server_num(server_num), customers(customers), served_customer_num(0), begin_serve_sem(0, max(customers.size(), server_num)), time_slice(time_slice = 100) {}
+    Engine(int server_num, std::vector<Customer> customers, dispatch_policy policy = dispatch_policy::SHARED, queue_discipline discipline = queue_discipline::FIFO): server_num(server_num), served_customer_num(0), customers(customers.begin(), customers.end()), dispatcher(server_num, policy, discipline), begin_serve_sem(0, max(customers.size(), server_num))
+    {
+        for (const Customer &customer : customers)
+        {
+            dispatcher.add_customer(customer);
+        }
+        begin_serve_sem.SetName("begin_serve_sem");
+
+        // with a local queue per server, each server waits on its own counter
+        if (!dispatcher.shares_work())
+        {
+            server_sems.reserve(server_num);
+            for (int i = 0; i < server_num; ++i)
+            {
+                server_sems.emplace_back(0, max(customers.size(), 1));
+                server_sems.back().SetName("server_sems[" + std::to_string(i) + "]");
+            }
+        }
+    }
+
+    void set_output_file(const std::string &file_name)
+    {
+        output_file_name = file_name;
+    }
+
+    // also write a Chrome trace of arrivals and service segments, one lane per server
+    void set_trace_file(const std::string &file_name)
+    {
+        trace_file_name = file_name;
+        trace = std::make_unique<tracing::TraceRecorder>(1000); // one time step is shown as 1 ms
+        trace->set_lane_name(0, 0, "arrivals");
+        for (int i = 0; i < server_num; ++i)
+        {
+            trace->set_lane_name(0, i + 1, trace->intern("server " + std::to_string(i)));
+        }
+    }
+
+    const ResultTable &get_results() const
+    {
+        return results;
+    }
+
+    int get_preemption_num() const
+    {
+        return preemption_num;
+    }
+
+    // customers queued for a server in the virtual mode
+    int get_waiting_num() const
+    {
+        return dispatcher.pending();
+    }
+
+    int get_busy_server_num() const
+    {
+        return server_num - (int)sim.idle_servers.size();
+    }
+
+    // the real-time length of one time step in the threaded mode, 100 ms by default
+    void set_time_slice(std::chrono::microseconds slice)
+    {
+        time_slice = slice;
+    }
 
     ~Engine()
     {
@@ -37,16 +117,11 @@ public:
 
     void execute()
     {
-        start_time = get_time_stamp_milliseconds();
-
-        customer_served_info.reserve(customers.size());
-        for (int i = 0; i < customers.size(); ++i)
-        {
-            std::vector<int> single_customer_served_info(4);
-            customer_served_info.push_back(single_customer_served_info);
-        }
+        start_point = std::chrono::steady_clock::now();
+        init_served_info();
 
         // begin all the server threads
+        serve_logs = std::vector<ServeLog>(server_num);
         server_threads.reserve(server_num);
         for (int i = 0; i < server_num; ++i)
         {
@@ -61,6 +136,11 @@ public:
             customer_threads.emplace_back(&Engine::run_customer, this, std::ref(customers[i]));
             print_thread_safely({"Customer ", std::to_string(i), " is ready"});
         }
+
+        // the clock starts once every thread exists, so thread creation does not eat into the first slices
+        start_point = std::chrono::steady_clock::now();
+        start_gate.Set();
+
         for (int i = 0; i < customers.size(); ++i)
         {
             customer_threads[i].join();
@@ -68,6 +148,10 @@ public:
 
         print_thread_safely({"All customers have been served"});
         begin_serve_sem.WakeUpAll();
+        for (auto &sem : server_sems)
+        {
+            sem.WakeUpAll();
+        }
 
         for (int i = 0; i < server_num; ++i)
         {
@@ -76,33 +160,547 @@ public:
                 server_threads[i].join();
             }
         }
+        std::vector<ServeSegment> segments;
+        for (const ServeLog &log : serve_logs)
+        {
+            segments.insert(segments.end(), log.segments.begin(), log.segments.end());
+        }
+        results.merge(std::move(segments));
+
+        output_result();
+        print_pacing_statistics();
+    }
+
+    // run the same bank without threads: time advances from event to event, and a finished
+    // service calls on_complete(customer, leave_time) instead of waking a blocked customer thread
+    void simulate(std::function<void(Customer &, int)> on_complete = nullptr)
+    {
+        begin_simulation(on_complete);
+        if (!checkpoint_file_name.empty() && std::ifstream(checkpoint_file_name) && load_checkpoint(checkpoint_file_name))
+        {
+            print_thread_safely({"Resumed at time ", std::to_string(next_event_time()), " from ", checkpoint_file_name});
+        }
+        advance_until(INT_MAX);
+        output_result();
+        if (!checkpoint_file_name.empty())
+        {
+            // the run is complete
+            for (const char *suffix : {"", ".rows", ".injected"})
+            {
+                std::remove((checkpoint_file_name + suffix).c_str());
+            }
+        }
+        if (checkpoint_num > 0)
+        {
+            std::cout << "Checkpoints: " << checkpoint_num << ", " << std::chrono::duration<double, std::milli>(checkpoint_time).count() / checkpoint_num << " ms each" << std::endl;
+        }
+    }
+
+    // Checkpoints of the virtual mode: advance_until() saves the state to `file` every
+    // `interval` time units, and simulate() goes on from a checkpoint of the same bank it finds
+    // there. The rows of the customers that changed since the previous checkpoint are appended
+    // to file + ".rows" and the injected customers to file + ".injected"; the checkpoint itself
+    // only holds the queues, servers and pending events, so its cost follows the customers in
+    // the bank rather than the length of the trace. The callbacks and the trace are not saved.
+    void set_checkpoint(const std::string &file, int interval)
+    {
+        checkpoint_file_name = file;
+        checkpoint_interval = interval;
+    }
+
+    void save_checkpoint(const std::string &file)
+    {
+        // the logs first: a checkpoint never refers to rows that are not on disk
+        std::vector<CustomerRow> rows;
+        rows.reserve(sim.changed.size());
+        for (int i : sim.changed)
+        {
+            rows.push_back(CustomerRow{i, {results.load(i, IN_BANK), results.load(i, BEGIN_SERVE), results.load(i, LEAVE_BANK), results.load(i, SERVE_ID)}, dispatcher.get_progress(i), customers[i].is_served()});
+            sim.is_changed[i] = 0;
+        }
+        sim.changed.clear();
+        snapshot::append_log(file + ".rows", rows.data(), rows.size(), sim.logged_row_num == 0);
+        sim.logged_row_num += rows.size();
+        std::vector<Customer> injected(customers.begin() + sim.order.size() + sim.logged_injected_num, customers.end());
+        snapshot::append_log(file + ".injected", injected.data(), injected.size(), sim.logged_injected_num == 0);
+        sim.logged_injected_num += injected.size();
+
+        snapshot::Writer out(file, "BANK");
+        out.put(BankShape{server_num, dispatcher.get_policy(), dispatcher.get_discipline(), sim.order.size()});
+        out.put(sim.logged_row_num);
+        out.put(sim.logged_injected_num);
+        out.put(served_customer_num.load());
+        out.put(preemption_num.load());
+        dispatcher.save(out);
+
+        out.put(sim.next_arrival);
+        std::vector<std::pair<int64_t, int>> injected_arrivals = sim.injected.items();
+        out.put(uint64_t(injected_arrivals.size()));
+        for (auto &[tick, index] : injected_arrivals)
+        {
+            out.put(tick);
+            out.put(index);
+        }
+        std::vector<std::pair<int64_t, VirtualState::finish_event>> busy = sim.busy_servers.items();
+        out.put(uint64_t(busy.size()));
+        for (auto &[tick, event] : busy)
+        {
+            out.put(tick);
+            out.put(event.first);
+            out.put(event.second);
+        }
+        out.put_vector(std::vector<int>(sim.idle_servers.begin(), sim.idle_servers.end()));
+        std::vector<int> serving;
+        for (const Customer *customer : sim.serving)
+        {
+            serving.push_back(customer != nullptr ? customer->get_index() : -1);
+        }
+        out.put_vector(serving);
+        out.put_vector(sim.finish_time);
+        out.put_vector(sim.segment_start);
+        out.put_vector(sim.service_epoch);
+        out.put(sim.overflow_threshold);
+        out.commit();
+    }
+
+    // right after begin_simulation(); false, with nothing changed, if the checkpoint is of another bank
+    bool load_checkpoint(const std::string &file)
+    {
+        snapshot::Reader in(file, "BANK");
+        BankShape shape = in.get<BankShape>();
+        if (shape.server_num != server_num || shape.policy != dispatcher.get_policy() || shape.discipline != dispatcher.get_discipline() || shape.initial_customer_num != sim.order.size())
+        {
+            return false;
+        }
+        in.get(sim.logged_row_num);
+        in.get(sim.logged_injected_num);
+        served_customer_num = in.get<int>();
+        preemption_num = in.get<int>();
+
+        // the injected customers come again, then every changed row in the order it was saved
+        for (const Customer &customer : snapshot::read_log<Customer>(file + ".injected", sim.logged_injected_num))
+        {
+            customers.push_back(customer);
+            dispatcher.add_customer(customer);
+            sim.transferred_in.push_back(1);
+        }
+        results.grow(customers.size());
+        for (const CustomerRow &row : snapshot::read_log<CustomerRow>(file + ".rows", sim.logged_row_num))
+        {
+            for (int column = 0; column < ResultTable::column_num; ++column)
+            {
+                results.store(row.index, column, row.cells[column]);
+            }
+            dispatcher.set_progress(row.index, row.progress);
+            if (row.served)
+            {
+                customers[row.index].up();
+            }
+        }
+        auto customer = [this](int index) { return &customers[index]; };
+        dispatcher.load(in, customer);
 
+        in.get(sim.next_arrival);
+        sim.injected.clear();
+        for (uint64_t n = in.get<uint64_t>(); n > 0; --n)
+        {
+            int64_t tick = in.get<int64_t>();
+            sim.injected.push(tick, in.get<int>());
+        }
+        sim.busy_servers.clear();
+        for (uint64_t n = in.get<uint64_t>(); n > 0; --n)
+        {
+            int64_t tick = in.get<int64_t>();
+            int server_id = in.get<int>();
+            sim.busy_servers.push(tick, {server_id, in.get<int>()});
+        }
+        std::vector<int> idle = in.get_vector<int>();
+        sim.idle_servers = std::set<int>(idle.begin(), idle.end());
+        std::vector<int> serving = in.get_vector<int>();
+        for (int server_id = 0; server_id < server_num; ++server_id)
+        {
+            sim.serving[server_id] = serving[server_id] >= 0 ? customer(serving[server_id]) : nullptr;
+        }
+        sim.finish_time = in.get_vector<int>();
+        sim.segment_start = in.get_vector<int>();
+        sim.service_epoch = in.get_vector<int>();
+        in.get(sim.overflow_threshold);
+        return true;
+    }
+
+    // The virtual mode can also be driven step by step: begin_simulation() once, then
+    // advance_until() any number of times, possibly with inject() in between.
+    void begin_simulation(std::function<void(Customer &, int)> on_complete = nullptr)
+    {
+        start_point = std::chrono::steady_clock::now();
+        init_served_info();
+
+        sim.on_complete = on_complete;
+        sim.order.resize(customers.size());
+        std::iota(sim.order.begin(), sim.order.end(), 0);
+        std::stable_sort(sim.order.begin(), sim.order.end(), [this](int a, int b) { return customers[a].get_start_time() < customers[b].get_start_time(); });
+        sim.next_arrival = 0;
+        sim.serving.assign(server_num, nullptr);
+        sim.finish_time.assign(server_num, 0);
+        sim.segment_start.assign(server_num, 0);
+        sim.service_epoch.assign(server_num, 0);
+        sim.transferred_in.assign(customers.size(), 0);
+        sim.idle_servers.clear();
+        for (int i = 0; i < server_num; ++i)
+        {
+            sim.idle_servers.insert(i);
+        }
+    }
+
+    // process every event that happens before end_time
+    void advance_until(int end_time)
+    {
+        while (true)
+        {
+            int now = next_event_time();
+            if (now == INT_MAX || now >= end_time)
+            {
+                break;
+            }
+            if (checkpoint_interval > 0 && now >= next_checkpoint)
+            {
+                if (next_checkpoint > 0)
+                {
+                    auto begin = std::chrono::steady_clock::now();
+                    save_checkpoint(checkpoint_file_name);
+                    checkpoint_time += std::chrono::steady_clock::now() - begin;
+                    checkpoint_num++;
+                }
+                next_checkpoint = now - now % checkpoint_interval + checkpoint_interval;
+            }
+            step(now);
+        }
+    }
+
+    // the time of the earliest pending event, INT_MAX if there is none
+    int next_event_time()
+    {
+        int next = INT_MAX;
+        if (!sim.busy_servers.empty())
+        {
+            next = sim.busy_servers.top_tick();
+        }
+        if (sim.next_arrival < sim.order.size())
+        {
+            next = std::min(next, customers[sim.order[sim.next_arrival]].get_start_time());
+        }
+        if (!sim.injected.empty())
+        {
+            next = std::min<int>(next, sim.injected.top_tick());
+        }
+        return next;
+    }
+
+    // add a customer coming from elsewhere (another branch), it arrives at start_time and is never transferred again
+    int inject(int start_time, int service_time, int priority = 0)
+    {
+        if (!retired.empty())
+        {
+            int index = retired.back();
+            retired.pop_back();
+            customers[index] = Customer(index, start_time, service_time, priority);
+            dispatcher.reuse_customer(customers[index]);
+            for (int column = 0; column < ResultTable::column_num; ++column)
+            {
+                results.store(index, column, 0);
+            }
+            sim.transferred_in[index] = 1;
+            sim.injected.push(start_time, index);
+            return index;
+        }
+        int index = customers.size();
+        customers.emplace_back(index, start_time, service_time, priority);
+        dispatcher.add_customer(customers.back());
+        results.grow(customers.size());
+        sim.transferred_in.push_back(1);
+        sim.injected.push(start_time, index);
+        return index;
+    }
+
+    // A long-running virtual engine fed by inject() retires every customer who has left, and
+    // the next inject() reuses its index, so the per-customer state follows the customers in
+    // the bank rather than all that ever came. The results of a retired customer are gone, so
+    // on_complete must read them first. Checkpoints log customers by index and cannot be used.
+    void retire(int index)
+    {
+        if (checkpoint_interval > 0)
+        {
+            throw std::logic_error{"Customers cannot be retired by an engine that checkpoints!"};
+        }
+        retired.push_back(index);
+    }
+
+    // an arriving customer who finds at least `threshold` customers waiting is handed to
+    // on_overflow(customer, now) instead of queueing here; threshold < 0 disables transfers
+    void set_overflow(int threshold, std::function<void(const Customer &, int)> on_overflow)
+    {
+        sim.overflow_threshold = threshold;
+        sim.on_overflow = on_overflow;
+    }
+
+    // results of the virtual mode, a transferred customer is recorded with SERVE_ID -1
+    void finish_simulation()
+    {
         output_result();
     }
 
+    size_t get_customer_num() const
+    {
+        return customers.size();
+    }
+
+    const Customer &get_customer(int index) const
+    {
+        return customers[index];
+    }
+
 private:
+    // what a checkpoint must match to be resumed by this engine
+    struct BankShape
+    {
+        int server_num;
+        dispatch_policy policy;
+        queue_discipline discipline;
+        size_t initial_customer_num;
+    };
+
+    // everything a step may change about one customer
+    struct CustomerRow
+    {
+        int index;
+        int cells[ResultTable::column_num];
+        Dispatcher::Progress progress;
+        bool served;
+    };
+
+    // state of the virtual mode between calls of advance_until
+    struct VirtualState
+    {
+        using finish_event = std::pair<int, int>; // (server id, service epoch), keyed on the leave time
+
+        std::vector<int> order; // the initial customers in order of arrival
+        size_t next_arrival = 0;
+        TimingWheel<int> injected; // customer indices keyed on the arrival time
+        TimingWheel<finish_event> busy_servers;
+        std::set<int> idle_servers;
+        std::vector<int> touched_servers; // servers whose queue or state changed at this time
+        std::vector<Customer *> serving;
+        std::vector<int> finish_time;
+        std::vector<int> segment_start; // when the current service segment of each server began
+        std::vector<int> service_epoch; // bumped on preemption, stale finish events are skipped
+        std::vector<char> transferred_in;
+        std::function<void(Customer &, int)> on_complete;
+        int overflow_threshold = -1;
+        std::function<void(const Customer &, int)> on_overflow;
+        std::vector<char> is_changed; // customers changed since the last checkpoint, when checkpointing
+        std::vector<int> changed;
+        size_t logged_row_num = 0;
+        size_t logged_injected_num = 0;
+    };
+
+    // handle every event at time `now`
+    void step(int now)
+    {
+        sim.touched_servers.clear();
+
+        // finish services first, so that a freed server can take a customer arriving now
+        while (!sim.busy_servers.empty() && sim.busy_servers.top_tick() == now)
+        {
+            int server_id = sim.busy_servers.top().first;
+            sim.busy_servers.pop();
+            Customer &customer = *sim.serving[server_id];
+            mark_changed(customer.get_index());
+            results.store(customer.get_index(), LEAVE_BANK, now);
+            trace_serve(server_id, customer, sim.segment_start[server_id], now, false);
+            customer.up();
+            served_customer_num++;
+            dispatcher.finish(server_id);
+            sim.idle_servers.insert(server_id);
+            sim.touched_servers.push_back(server_id);
+            if (sim.on_complete)
+            {
+                sim.on_complete(customer, now);
+            }
+            drop_stale_events();
+        }
+
+        while (sim.next_arrival < sim.order.size() && customers[sim.order[sim.next_arrival]].get_start_time() == now)
+        {
+            arrive(customers[sim.order[sim.next_arrival++]], now);
+        }
+        while (!sim.injected.empty() && sim.injected.top_tick() == now)
+        {
+            int index = sim.injected.top();
+            sim.injected.pop();
+            arrive(customers[index], now);
+        }
+
+        if (dispatcher.shares_work())
+        {
+            // any idle server may take any waiting customer, lowest id first
+            while (!sim.idle_servers.empty() && dispatcher.pending() > 0)
+            {
+                int server_id = *sim.idle_servers.begin();
+                begin_serve(server_id, dispatcher.take(server_id), now);
+            }
+        }
+        else
+        {
+            // only a server whose own queue changed can start a new service
+            for (int server_id : sim.touched_servers)
+            {
+                if (sim.idle_servers.count(server_id))
+                {
+                    Customer *customer_ptr = dispatcher.take(server_id);
+                    if (customer_ptr != nullptr)
+                    {
+                        begin_serve(server_id, customer_ptr, now);
+                    }
+                }
+            }
+        }
+
+        if (dispatcher.preemptive())
+        {
+            if (dispatcher.get_policy() == dispatch_policy::SHARED)
+            {
+                // the shared queue competes with the busy server that has the most work left
+                while (dispatcher.pending() > 0)
+                {
+                    int longest = 0;
+                    for (int i = 1; i < server_num; ++i)
+                    {
+                        if (sim.finish_time[i] > sim.finish_time[longest])
+                        {
+                            longest = i;
+                        }
+                    }
+                    if (dispatcher.peek_remaining(longest) >= sim.finish_time[longest] - now)
+                    {
+                        break;
+                    }
+                    preempt(longest, now);
+                }
+            }
+            else
+            {
+                for (int server_id : sim.touched_servers)
+                {
+                    if (!sim.idle_servers.count(server_id) && dispatcher.should_preempt(server_id, sim.finish_time[server_id] - now))
+                    {
+                        preempt(server_id, now);
+                    }
+                }
+            }
+            drop_stale_events();
+        }
+    }
+
+    void arrive(Customer &customer, int now)
+    {
+        mark_changed(customer.get_index());
+        results.store(customer.get_index(), IN_BANK, now);
+        trace_arrival(customer, now);
+        int waiting = dispatcher.pending() - (int)sim.idle_servers.size();
+        if (sim.overflow_threshold >= 0 && !sim.transferred_in[customer.get_index()] && waiting >= sim.overflow_threshold)
+        {
+            results.store(customer.get_index(), BEGIN_SERVE, now);
+            results.store(customer.get_index(), LEAVE_BANK, now);
+            results.store(customer.get_index(), SERVE_ID, -1);
+            if (trace)
+            {
+                trace->instant(0, 0, now, "transfer ", customer.get_index());
+            }
+            sim.on_overflow(customer, now);
+            return;
+        }
+        sim.touched_servers.push_back(dispatcher.route(&customer));
+    }
+
+    void begin_serve(int server_id, Customer *customer_ptr, int now)
+    {
+        mark_changed(customer_ptr->get_index());
+        sim.idle_servers.erase(server_id);
+        if (dispatcher.first_service(customer_ptr))
+        {
+            results.store(customer_ptr->get_index(), BEGIN_SERVE, now);
+        }
+        results.store(customer_ptr->get_index(), SERVE_ID, server_id);
+        sim.serving[server_id] = customer_ptr;
+        sim.segment_start[server_id] = now;
+        sim.finish_time[server_id] = now + dispatcher.remaining(customer_ptr);
+        sim.busy_servers.push(sim.finish_time[server_id], {server_id, sim.service_epoch[server_id]});
+    }
+
+    // SRPT: put the customer of this server back and serve the shorter one waiting for it
+    void preempt(int server_id, int now)
+    {
+        mark_changed(sim.serving[server_id]->get_index());
+        trace_serve(server_id, *sim.serving[server_id], sim.segment_start[server_id], now, true);
+        dispatcher.requeue(server_id, sim.serving[server_id], sim.finish_time[server_id] - now);
+        sim.service_epoch[server_id]++;
+        preemption_num++;
+        begin_serve(server_id, dispatcher.take(server_id), now);
+    }
+
+    // the customer goes into the next checkpoint
+    void mark_changed(int index)
+    {
+        if (checkpoint_interval <= 0)
+        {
+            return;
+        }
+        if (index >= (int)sim.is_changed.size())
+        {
+            sim.is_changed.resize(customers.size());
+        }
+        if (!sim.is_changed[index])
+        {
+            sim.is_changed[index] = 1;
+            sim.changed.push_back(index);
+        }
+    }
+
+    void drop_stale_events()
+    {
+        while (!sim.busy_servers.empty() && sim.busy_servers.top().second != sim.service_epoch[sim.busy_servers.top().first])
+        {
+            sim.busy_servers.pop();
+        }
+    }
+
+    void init_served_info()
+    {
+        results.resize(customers.size());
+    }
+
     void run_customer(Customer& customer)
     {
+        start_gate.Wait();
         int wait_time = customer.get_start_time();
         print_thread_safely({"Customer ", std::to_string(customer.get_index()), " will come after ", std::to_string(wait_time), " time slides"});
-        // wait some time, using std::chrono
-        std::this_thread::sleep_for(std::chrono::milliseconds(wait_time * time_slice));
+        // wait until the arrival slice begins
+        sleep_until_slice(wait_time);
 
         // get the number (which means enqueue)
-        {
-            std::unique_lock<std::mutex> lock(enqueue_mtx);
-            customer_queue.emplace(&customer);
-            begin_serve_sem.Up();
-            print_thread_safely({"Customer ", std::to_string(customer.get_index()), " is entering the bank"});
-            customer_served_info[customer.get_index()][IN_BANK] = get_time_slice();
-        }
+        int arrive_slice = get_time_slice();
+        results.store(customer.get_index(), IN_BANK, arrive_slice);
+        trace_arrival(customer, arrive_slice);
+        int target = dispatcher.route(&customer);
+        print_thread_safely({"Customer ", std::to_string(customer.get_index()), " is entering the bank"});
+        wakeup_sem(target).Up();
 
         // wait the service
         customer.down();
 
         // leave the bank
         print_thread_safely({"Customer ", std::to_string(customer.get_index()), " is leaving the bank"});
-        customer_served_info[customer.get_index()][LEAVE_BANK] = get_time_slice();
+        results.store(customer.get_index(), LEAVE_BANK, get_time_slice());
     };
 
     void run_server(int server_id)
@@ -110,7 +708,7 @@ private:
         while (true)
         {
             // wait for the queue to be not empty
-            begin_serve_sem.Down();
+            wakeup_sem(server_id).Down();
 
             if (detect_stopable())
             {
@@ -118,26 +716,86 @@ private:
                 break;
             }
 
-            // dequeue
-            Customer* customer_ptr = nullptr;
+            // dequeue, a successful Down guarantees one customer this server may take,
+            // but with stealing another server can empty the chosen queue first, so retry;
+            // the wakeup at the end finds no customer either, so stop when all are served
+            Customer* customer_ptr = dispatcher.take(server_id);
+            while (customer_ptr == nullptr && !detect_stopable())
+            {
+                std::this_thread::yield();
+                customer_ptr = dispatcher.take(server_id);
+            }
+            if (customer_ptr == nullptr)
             {
-                std::unique_lock<std::mutex> lock(dequeue_mtx);
-                customer_ptr = customer_queue.front();
-                customer_queue.pop();
-                print_thread_safely({"Server ", std::to_string(server_id), " is serving customer ", std::to_string(customer_ptr->get_index())});
-                customer_served_info[customer_ptr->get_index()][BEGIN_SERVE] = get_time_slice();
-                customer_served_info[customer_ptr->get_index()][SERVE_ID] = server_id;
+                print_thread_safely({"Server ", std::to_string(server_id), " is stopping"});
+                break;
             }
+            print_thread_safely({"Server ", std::to_string(server_id), " is serving customer ", std::to_string(customer_ptr->get_index())});
+            int begin_slice = get_time_slice();
+            serve_logs[server_id].segments.push_back(ServeSegment{customer_ptr->get_index(), begin_slice, server_id, dispatcher.first_service(customer_ptr)});
 
-            // service
-            std::this_thread::sleep_for(std::chrono::milliseconds(customer_ptr->get_service_time() * time_slice));
+            // service, the end is an absolute slice so that lateness does not accumulate
+            if (!dispatcher.preemptive())
+            {
+                sleep_until_slice(begin_slice + customer_ptr->get_service_time());
+            }
+            else if (!serve_preemptively(server_id, customer_ptr, begin_slice))
+            {
+                continue; // put back into the queue, not finished
+            }
 
             // finish customer thread
+            trace_serve(server_id, *customer_ptr, begin_slice, get_time_slice(), false);
+            dispatcher.finish(server_id);
+            served_customer_num++; // before the customer thread can exit and the servers be woken up
             customer_ptr->up();
-            served_customer_num++;
         }
     };
 
+    // serve one time slice at a time, returns false if a shorter customer took over the server
+    bool serve_preemptively(int server_id, Customer *customer_ptr, int begin_slice)
+    {
+        int remaining = dispatcher.remaining(customer_ptr);
+        for (int slice = begin_slice + 1; remaining > 0; ++slice)
+        {
+            sleep_until_slice(slice);
+            remaining--;
+            if (remaining > 0 && dispatcher.should_preempt(server_id, remaining))
+            {
+                print_thread_safely({"Server ", std::to_string(server_id), " preempts customer ", std::to_string(customer_ptr->get_index())});
+                trace_serve(server_id, *customer_ptr, begin_slice, slice, true);
+                dispatcher.requeue(server_id, customer_ptr, remaining);
+                preemption_num++;
+                wakeup_sem(server_id).Up();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void trace_arrival(const Customer &customer, int now)
+    {
+        if (trace)
+        {
+            trace->instant(0, 0, now, "arrive ", customer.get_index(), "priority", customer.get_priority());
+        }
+    }
+
+    // one service segment, a preempted one ends before the customer is finished
+    void trace_serve(int server_id, const Customer &customer, int begin, int end, bool preempted)
+    {
+        if (trace)
+        {
+            trace->complete(0, server_id + 1, begin, end, "customer ", customer.get_index(), "preempted", preempted);
+        }
+    }
+
+    // the counter a server sleeps on: shared by all servers, or its own one
+    Semaphore &wakeup_sem(int server_id)
+    {
+        return dispatcher.shares_work() ? begin_serve_sem : server_sems[server_id];
+    }
+
     bool detect_stopable()
     {
         std::unique_lock<std::mutex> lock(detect_mtx);
@@ -162,48 +820,119 @@ private:
         std::cout << str << std::endl;
     }
 
-    int64_t get_time_stamp_milliseconds()
+    // the index of the current time slice, counted from the start on the monotonic clock
+    int get_time_slice()
     {
-        auto now = std::chrono::system_clock::now();
-        auto now_c = std::chrono::system_clock::to_time_t(now);
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
-        return ms.count();
+        return (std::chrono::steady_clock::now() - start_point) / time_slice;
     }
 
-    int get_time_slice()
+    // Sleep until the given slice begins. The wakeup is an absolute deadline on CLOCK_MONOTONIC
+    // (the clock behind steady_clock), set slightly early and finished by spinning, so neither
+    // the sleep granularity nor the time spent between waits adds up across slices.
+    void sleep_until_slice(int slice)
+    {
+        auto deadline = start_point + slice * time_slice;
+        auto wakeup = deadline - spin_margin;
+        if (wakeup > std::chrono::steady_clock::now())
+        {
+            auto since_epoch = std::chrono::duration_cast<std::chrono::nanoseconds>(wakeup.time_since_epoch());
+            struct timespec ts;
+            ts.tv_sec = since_epoch.count() / 1000000000;
+            ts.tv_nsec = since_epoch.count() % 1000000000;
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR)
+            {
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        while (now < deadline)
+        {
+            now = std::chrono::steady_clock::now();
+        }
+
+        // how late the thread really woke up
+        int64_t late_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline).count();
+        pacing_wait_num++;
+        pacing_late_total_ns += late_ns;
+        int64_t prev_max = pacing_late_max_ns.load();
+        while (late_ns > prev_max && !pacing_late_max_ns.compare_exchange_weak(prev_max, late_ns))
+        {
+        }
+    }
+
+    void print_pacing_statistics()
     {
-        int64_t now_time = get_time_stamp_milliseconds();
-        int64_t time_diff = now_time - start_time;
-        return std::round((float)time_diff / time_slice);
+        int64_t waits = pacing_wait_num.load();
+        if (waits == 0)
+        {
+            return;
+        }
+        std::cout << "Pacing: time slice " << time_slice.count() << " us, " << waits << " waits, lateness mean "
+                  << pacing_late_total_ns.load() / waits / 1000.0 << " us, max " << pacing_late_max_ns.load() / 1000.0 << " us" << std::endl;
     }
 
     void output_result()
     {
-        // output the result into a file, like a table, use customer_served_info
-        std::ofstream fout("output.txt");
-        for (int i = 0; i < customers.size(); ++i)
+        // output the result into a file, the format follows the extension: .csv, .bin, or a plain table
+        auto ends_with = [this](const std::string &suffix) {
+            return output_file_name.size() >= suffix.size() && output_file_name.compare(output_file_name.size() - suffix.size(), suffix.size(), suffix) == 0;
+        };
+        if (ends_with(".bin"))
         {
-            fout << i << " " \
-                 << customer_served_info[i][IN_BANK] << " " << customer_served_info[i][BEGIN_SERVE] << " " \
-                 << customer_served_info[i][LEAVE_BANK] << " " << customer_served_info[i][SERVE_ID] << std::endl;
+            std::ofstream fout(output_file_name, std::ios::binary);
+            results.write_binary(fout);
+        }
+        else if (ends_with(".csv"))
+        {
+            std::ofstream fout(output_file_name);
+            results.write_csv(fout);
+        }
+        else
+        {
+            std::ofstream fout(output_file_name);
+            results.write_text(fout);
+        }
+        if (trace)
+        {
+            trace->flush(trace_file_name);
         }
     }
 
 private:
     int server_num;
-    int time_slice;
-    int64_t start_time;
+    std::chrono::microseconds time_slice{100000};
+    std::chrono::microseconds spin_margin{200}; // how long before a deadline sleeping turns into spinning
+    std::chrono::steady_clock::time_point start_point;
+    std::atomic<int64_t> pacing_wait_num{0};
+    std::atomic<int64_t> pacing_late_total_ns{0};
+    std::atomic<int64_t> pacing_late_max_ns{0};
     std::atomic<int> served_customer_num;
-    std::vector<Customer> customers;
+    std::atomic<int> preemption_num{0};
+    std::deque<Customer> customers; // a deque, so that injected customers do not move the others
+    std::vector<int> retired; // indices free for inject() to reuse
     std::vector<std::thread> server_threads;
     std::vector<std::thread> customer_threads;
-    std::vector<std::vector<int>> customer_served_info;
-    std::queue<Customer*> customer_queue;
-    mutable std::mutex enqueue_mtx;
-    mutable std::mutex dequeue_mtx;
+    ResultTable results;
+    struct alignas(64) ServeLog
+    {
+        std::vector<ServeSegment> segments;
+    };
+    std::vector<ServeLog> serve_logs; // per server in the thread mode, merged into results after the join
+    std::string output_file_name = "output.txt";
+    Dispatcher dispatcher;
     mutable std::mutex detect_mtx;
     mutable std::mutex print_mtx;
     Semaphore begin_serve_sem;
+    primitives::Event<> start_gate;
+    std::vector<Semaphore> server_sems;
+    VirtualState sim;
+    std::string checkpoint_file_name;
+    int checkpoint_interval = 0;
+    int next_checkpoint = 0; // the first checkpoint is only set when the first event comes
+    int checkpoint_num = 0;
+    std::chrono::steady_clock::duration checkpoint_time{0};
+    std::unique_ptr<tracing::TraceRecorder> trace; // null unless a trace file is set
+    std::string trace_file_name;
 };
 
 #endif // ENGINE_HPP
\ No newline at end of file
@@ -2,13 +2,70 @@
 #include <vector>
 #include <fstream>
 #include <algorithm>
+#include <sstream>
+#include <string>
 
 #include "engine.hpp"
+#include "stream.hpp"
+
+// mean and tail of a list of durations
+void print_distribution(const std::string &name, std::vector<int> values)
+{
+    if (values.empty())
+    {
+        return;
+    }
+    long long total = 0;
+    for (int v : values)
+    {
+        total += v;
+    }
+    auto percentile = [&values](double p) {
+        size_t k = (size_t)(p * (values.size() - 1));
+        std::nth_element(values.begin(), values.begin() + k, values.end());
+        return values[k];
+    };
+    int p50 = percentile(0.5);
+    int p90 = percentile(0.9);
+    int p99 = percentile(0.99);
+    int max_value = *std::max_element(values.begin(), values.end());
+    std::cout << name << ": mean " << (double)total / values.size() << ", p50 " << p50 << ", p90 " << p90 << ", p99 " << p99 << ", max " << max_value << std::endl;
+}
+
+// wait: entering the bank until the first service, response: entering until leaving
+void print_wait_statistics(const ResultTable &results, const std::vector<Customer> &customers)
+{
+    std::vector<int> wait(results.size());
+    std::vector<int> response(results.size());
+    std::vector<std::vector<int>> class_wait;
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        wait[i] = results.load(i, BEGIN_SERVE) - results.load(i, IN_BANK);
+        response[i] = results.load(i, LEAVE_BANK) - results.load(i, IN_BANK);
+        int priority = customers[i].get_priority();
+        if (priority >= (int)class_wait.size())
+        {
+            class_wait.resize(priority + 1);
+        }
+        class_wait[priority].push_back(wait[i]);
+    }
+    print_distribution("Wait time", wait);
+    print_distribution("Response time", response);
+    if (class_wait.size() > 1)
+    {
+        for (size_t priority = 0; priority < class_wait.size(); ++priority)
+        {
+            print_distribution("Wait time of class " + std::to_string(priority), class_wait[priority]);
+        }
+    }
+}
 
 int main(int argc, char **argv)
 {
     int n_servers = 5;
     std::string test_file_name = "test.txt";
+    bool virtual_time = false;
+    bool stream = false;
 
     if (argc > 1)
     {   
@@ -21,24 +78,123 @@ int main(int argc, char **argv)
         std::cout << "use default settings" << "n_servers = " << n_servers << std::endl;
     }
 
+    if (argc > 2)
+    {
+        // thread: one thread per customer and server, paced in real time
+        // virtual: event-driven simulation without threads
+        // stream: the virtual mode fed with arrivals from stdin or a UNIX socket
+        virtual_time = std::string(argv[2]) == "virtual";
+        stream = std::string(argv[2]) == "stream";
+        std::cout << "Mode: " << (stream ? "stream" : virtual_time ? "virtual" : "thread") << std::endl;
+    }
+
+    std::string output_file_name = "output.txt";
+    if (argc > 3)
+    {
+        // output.txt, *.csv or *.bin
+        output_file_name = argv[3];
+    }
+
+    dispatch_policy policy = dispatch_policy::SHARED;
+    if (argc > 4)
+    {
+        // shared | rr | jsq | p2c | steal
+        policy = parse_dispatch_policy(argv[4]);
+        std::cout << "Dispatch policy: " << dispatch_policy_name(policy) << std::endl;
+    }
+
+    queue_discipline discipline = queue_discipline::FIFO;
+    if (argc > 5)
+    {
+        // fifo | sjf | priority | srpt
+        discipline = parse_queue_discipline(argv[5]);
+        std::cout << "Queue discipline: " << queue_discipline_name(discipline) << std::endl;
+    }
+
+    if (stream)
+    {
+        // ./main servers stream [- | socket path] [policy] [discipline] [window] [capacity]
+        std::string source = argc > 3 ? argv[3] : "-";
+        int window = argc > 6 ? std::stoi(argv[6]) : 1000;
+        int capacity = argc > 7 ? std::stoi(argv[7]) : 65536;
+        StreamService service(n_servers, policy, discipline, window, capacity);
+        service.run(source);
+        return 0;
+    }
+
+    int time_slice_us = 100000;
+    if (argc > 6)
+    {
+        // real-time length of a time step in the thread mode, in microseconds
+        time_slice_us = std::stoi(argv[6]);
+        std::cout << "Time slice: " << time_slice_us << " us" << std::endl;
+    }
+
+    std::string trace_file_name;
+    if (argc > 7 && std::string(argv[7]) != "-")
+    {
+        // Chrome trace JSON, open it in ui.perfetto.dev or chrome://tracing
+        trace_file_name = argv[7];
+    }
+
+    std::string checkpoint_file_name;
+    int checkpoint_interval = 100000;
+    if (argc > 8)
+    {
+        // virtual mode: save the state every checkpoint_interval time units, resume from it on the next run
+        checkpoint_file_name = argv[8];
+        checkpoint_interval = argc > 9 ? std::stoi(argv[9]) : checkpoint_interval;
+    }
+
     // open the file to read the data
     std::vector<int> start_time;
     std::vector<int> service_time;
+    std::vector<int> priority;
 
-    // read the data from the file
+    // read the data from the file, an optional fourth column is the priority class
     std::ifstream infile(test_file_name);
-    int a, b, c;
-    while (infile >> a >> b >> c)
+    std::string line;
+    while (std::getline(infile, line))
     {
+        std::istringstream fields(line);
+        int a, b, c, d = 0;
+        if (!(fields >> a >> b >> c))
+        {
+            continue;
+        }
+        fields >> d;
         start_time.push_back(b);
         service_time.push_back(c);
-    } 
+        priority.push_back(d);
+    }
 
     // construct the customers
     std::vector<Customer> customers;
     for (int i = 0; i < start_time.size(); ++i)
     {
-        customers.push_back(Customer(i, start_time[i], service_time[i]));
+        customers.push_back(Customer(i, start_time[i], service_time[i], priority[i]));
+    }
+
+    // construct the engine
+    Engine engine(n_servers, customers, policy, discipline);
+    engine.set_output_file(output_file_name);
+    engine.set_time_slice(std::chrono::microseconds(time_slice_us));
+    if (!trace_file_name.empty())
+    {
+        engine.set_trace_file(trace_file_name);
+    }
+    if (virtual_time)
+    {
+        if (!checkpoint_file_name.empty())
+        {
+            engine.set_checkpoint(checkpoint_file_name, checkpoint_interval);
+        }
+        int last_leave_time = 0;
+        engine.simulate([&last_leave_time](Customer &, int leave_time) { last_leave_time = max(last_leave_time, leave_time); });
+        std::cout << "Served " << customers.size() << " customers, the last one left at " << last_leave_time << std::endl;
+        print_wait_statistics(engine.get_results(), customers);
+        std::cout << "Preemptions: " << engine.get_preemption_num() << std::endl;
+        return 0;
     }
 
     // print the info
@@ -46,8 +202,7 @@ int main(int argc, char **argv)
     {
         customers[i].print_info();
     }
-
-    // construct the engine
-    Engine engine(n_servers, customers);
     engine.execute();
+    print_wait_statistics(engine.get_results(), customers);
+    std::cout << "Preemptions: " << engine.get_preemption_num() << std::endl;
 }
\ No newline at end of file
@@ -0,0 +1,187 @@
+#include <atomic>
+#include <memory>
+#include <string>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+#include <vector>
+#include <ostream>
+#include <charconv>
+#include <algorithm>
+
+#ifndef RESULT_TABLE_HPP
+#define RESULT_TABLE_HPP
+
+// One service segment as a server thread records it in its own log (see ResultTable::merge)
+struct ServeSegment
+{
+    int index;
+    int begin; // the time slice the segment began
+    int server_id;
+    bool first; // the first segment of the customer, which sets BEGIN_SERVE
+};
+
+// Per-customer results stored column by column (structure of arrays) in one allocation.
+// Every column starts on its own cache line, so the IN_BANK/LEAVE_BANK cells the customer
+// threads write never share a line with the BEGIN_SERVE/SERVE_ID cells. Within a column,
+// neighbouring customers do share lines: in the thread mode the servers therefore do not
+// write the table at all, each logs its segments on its own and the logs are merged after
+// the threads are joined. Cells are written with relaxed atomic stores: each cell has a
+// single writer, and the table is only read after every thread has been joined.
+class ResultTable
+{
+public:
+    static constexpr int column_num = 4; // IN_BANK, BEGIN_SERVE, LEAVE_BANK, SERVE_ID
+    static constexpr size_t cache_line_size = 64;
+
+    ResultTable() = default;
+
+    explicit ResultTable(size_t row_num)
+    {
+        resize(row_num);
+    }
+
+    void resize(size_t new_row_num)
+    {
+        const size_t ints_per_line = cache_line_size / sizeof(int);
+        row_num = new_row_num;
+        stride = (row_num + ints_per_line - 1) / ints_per_line * ints_per_line;
+        if (stride == 0)
+        {
+            stride = ints_per_line;
+        }
+        size_t bytes = stride * column_num * sizeof(int);
+        data.reset(static_cast<int *>(std::aligned_alloc(cache_line_size, bytes)));
+        if (!data)
+        {
+            throw std::bad_alloc{};
+        }
+        std::memset(data.get(), 0, bytes);
+    }
+
+    // add rows at the end keeping the existing cells, the storage grows geometrically
+    void grow(size_t new_row_num)
+    {
+        if (new_row_num <= stride)
+        {
+            row_num = new_row_num;
+            return;
+        }
+        ResultTable bigger((std::max)(new_row_num, stride * 2));
+        for (int column = 0; column < column_num; ++column)
+        {
+            std::memcpy(bigger.mutable_column_data(column), column_data(column), row_num * sizeof(int));
+        }
+        bigger.row_num = new_row_num;
+        *this = std::move(bigger);
+    }
+
+    void store(size_t row, int column, int value)
+    {
+        std::atomic_ref<int>(mutable_column_data(column)[row]).store(value, std::memory_order_relaxed);
+    }
+
+    int load(size_t row, int column) const
+    {
+        return std::atomic_ref<int>(const_cast<int &>(column_data(column)[row])).load(std::memory_order_relaxed);
+    }
+
+    // BEGIN_SERVE and SERVE_ID (columns 1 and 3) from the segments logged by every server; a
+    // preempted customer keeps the server of its last segment
+    void merge(std::vector<ServeSegment> segments)
+    {
+        std::stable_sort(segments.begin(), segments.end(), [](const ServeSegment &a, const ServeSegment &b) { return a.begin < b.begin; });
+        for (const ServeSegment &segment : segments)
+        {
+            if (segment.first)
+            {
+                store(segment.index, 1, segment.begin);
+            }
+            store(segment.index, 3, segment.server_id);
+        }
+    }
+
+    const int *column_data(int column) const
+    {
+        return data.get() + column * stride;
+    }
+
+    size_t size() const
+    {
+        return row_num;
+    }
+
+    // "index in_bank begin_serve leave_bank serve_id" per line, the format of output.txt
+    void write_text(std::ostream &out) const
+    {
+        write_rows(out, ' ');
+    }
+
+    void write_csv(std::ostream &out) const
+    {
+        out << "index,in_bank,begin_serve,leave_bank,serve_id\n";
+        write_rows(out, ',');
+    }
+
+    // magic, row count, then each column as raw little-endian int32
+    void write_binary(std::ostream &out) const
+    {
+        const char magic[8] = {'B', 'A', 'N', 'K', 'R', 'E', 'S', '1'};
+        uint64_t rows = row_num;
+        out.write(magic, sizeof(magic));
+        out.write(reinterpret_cast<const char *>(&rows), sizeof(rows));
+        for (int column = 0; column < column_num; ++column)
+        {
+            out.write(reinterpret_cast<const char *>(column_data(column)), row_num * sizeof(int));
+        }
+    }
+
+private:
+    int *mutable_column_data(int column)
+    {
+        return data.get() + column * stride;
+    }
+
+    // rows are formatted into a fixed buffer and streamed out in large chunks
+    void write_rows(std::ostream &out, char separator) const
+    {
+        constexpr size_t buffer_size = 1 << 16;
+        constexpr size_t max_row_size = 80; // 20 digits for the index, 11 per column
+        std::unique_ptr<char[]> buffer(new char[buffer_size]);
+        char *p = buffer.get();
+        char *end = p + buffer_size;
+
+        for (size_t row = 0; row < row_num; ++row)
+        {
+            if (end - p < (ptrdiff_t)max_row_size)
+            {
+                out.write(buffer.get(), p - buffer.get());
+                p = buffer.get();
+            }
+            p = std::to_chars(p, end, row).ptr;
+            for (int column = 0; column < column_num; ++column)
+            {
+                *p++ = separator;
+                p = std::to_chars(p, end, column_data(column)[row]).ptr;
+            }
+            *p++ = '\n';
+        }
+        out.write(buffer.get(), p - buffer.get());
+    }
+
+    struct free_deleter
+    {
+        void operator()(int *p) const
+        {
+            std::free(p);
+        }
+    };
+
+    size_t row_num = 0;
+    size_t stride = 0; // ints between the starts of two columns
+    std::unique_ptr<int, free_deleter> data;
+};
+
+#endif // !RESULT_TABLE_HPP
@@ -1,63 +1,10 @@
-#include <mutex>
-#include <thread>
-#include <iostream>
-#include <stdexcept>
-#include <condition_variable>
-#include <cassert>
+#include "../common/sync.hpp"
 
 #ifndef SEMAPHORE_HPP
 #define SEMAPHORE_HPP
 
-class Semaphore
-{
-public:
-    Semaphore &operator=(const Semaphore &) = delete;
-
-    ~Semaphore() = default;
-
-    Semaphore(int init_count, int max_count) : cnt(init_count), max(max_count)
-    {
-        assert(init_count <= max_count && init_count >= 0 && max_count >= 0);
-    }
-
-    Semaphore(const Semaphore &sem) : cnt(sem.cnt), max(sem.max)
-    {
-        assert(cnt <= max && cnt >= 0 && max >= 0);
-    }
-
-    void Down()
-    {
-        std::unique_lock<std::mutex> lg{mtx};
-        while (cnt == 0) 
-        {
-            cv.wait(lg);
-        }
-        --cnt;
-    }
-
-    void Up()
-    {
-        std::unique_lock<std::mutex> lg{mtx};
-        if (cnt == max)
-        {
-            throw std::overflow_error{"The semaphore is full!"};
-        }
-        ++cnt;
-        cv.notify_one(); // notify the first thread waiting on the condition variable to get the lock
-    }
-
-    void WakeUpAll()
-    {
-        std::unique_lock<std::mutex> lg{mtx};
-        cnt = max;
-        cv.notify_all();
-    }
-
-private:
-    int cnt;
-    int max;
-    std::condition_variable cv;
-    mutable std::mutex mtx;
-};
+// the bank uses the shared primitives library, the backend is chosen at compile time
+// (-DSYNC_BACKEND_FUTEX / -DSYNC_BACKEND_SPIN, condvar by default)
+using Semaphore = primitives::Semaphore<primitives::DefaultBackend>;
 
 #endif // !SEMAPHORE_HPP
\ No newline at end of file
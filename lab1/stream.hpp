@@ -0,0 +1,374 @@
+#include <atomic>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <charconv>
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "engine.hpp"
+#include "../common/sync.hpp"
+
+#ifndef STREAM_HPP
+#define STREAM_HPP
+
+// one line of the feed, "index start_time service_time [priority]" as in test.txt
+struct Arrival
+{
+    int start_time;
+    int service_time;
+    int priority;
+};
+
+// Runs the virtual-time bank as a long-lived service fed with arrivals from stdin or a UNIX
+// socket. A reader thread parses the feed into batches and hands them to the simulation
+// through a bounded channel; when the simulation falls behind and the channel is full, the
+// reader stops reading, so the pipe or socket buffer fills up and the producer blocks
+// (backpressure). Arrivals must come in time order, a late one is moved to the current time.
+// No later arrival can come before the last one read, so the engine is advanced up to it
+// after every batch, and as each window of `window` time units closes its metrics are printed.
+// A customer is retired from the engine as soon as it leaves and its wait and response are
+// counted, and its slot goes to a later arrival, so memory follows the customers in the bank
+// and the current window, not the length of the feed.
+class StreamService
+{
+public:
+    StreamService(const StreamService &) = delete;
+    StreamService &operator=(const StreamService &) = delete;
+
+    // capacity: arrivals that may wait between the reader and the simulation, in batches of up to batch_size
+    StreamService(int server_num, dispatch_policy policy, queue_discipline discipline, int window, int capacity) : server_num(server_num), window(window), engine(server_num, {}, policy, discipline), channel(max(1, (capacity + batch_size - 1) / batch_size)), channel_capacity(max(1, (capacity + batch_size - 1) / batch_size))
+    {
+        if (window <= 0)
+        {
+            throw std::invalid_argument{"The window must be positive!"};
+        }
+        engine.set_output_file("/dev/null");
+    }
+
+    // "-" reads stdin until EOF; otherwise listens on a UNIX socket at that path and serves one
+    // connection after another until SIGINT or SIGTERM
+    void run(const std::string &source)
+    {
+        wall_start = std::chrono::steady_clock::now();
+        engine.begin_simulation([this](Customer &customer, int leave_time) { complete(customer, leave_time); });
+        std::thread reader(&StreamService::read_feed, this, source);
+
+        while (true)
+        {
+            std::vector<Arrival> batch = channel.Receive();
+            if (batch.empty())
+            {
+                break; // the feed is over
+            }
+            for (const Arrival &arrival : batch)
+            {
+                int start_time = arrival.start_time;
+                if (start_time < now)
+                {
+                    start_time = now;
+                    late_num++;
+                }
+                close_windows(start_time);
+                engine.inject(start_time, arrival.service_time, arrival.priority);
+                current.arrivals++;
+                now = start_time;
+            }
+            engine.advance_until(now);
+        }
+        reader.join();
+
+        // serve whoever is still in the bank, window by window
+        while (engine.next_event_time() != INT_MAX)
+        {
+            close_windows(engine.next_event_time());
+            now = max(now, engine.next_event_time());
+            engine.advance_until(now + 1);
+        }
+        print_window(max(now + 1, window_end - window + 1));
+        print_summary();
+    }
+
+private:
+    static constexpr size_t batch_size = 1024;
+
+    struct WindowStats
+    {
+        long long arrivals = 0;
+        long long served = 0;
+        std::vector<int> wait;
+        std::vector<int> response;
+    };
+
+    void complete(Customer &customer, int leave_time)
+    {
+        const ResultTable &results = engine.get_results();
+        int in_bank = results.load(customer.get_index(), IN_BANK);
+        current.served++;
+        current.wait.push_back(results.load(customer.get_index(), BEGIN_SERVE) - in_bank);
+        current.response.push_back(leave_time - in_bank);
+        served_num++;
+        engine.retire(customer.get_index());
+    }
+
+    // print every window that ends at or before time; stretches of idle windows are skipped
+    void close_windows(int time)
+    {
+        while (window_end <= time)
+        {
+            engine.advance_until(window_end);
+            bool idle = current.arrivals == 0 && current.served == 0;
+            if (!idle)
+            {
+                print_window(window_end);
+            }
+            current = WindowStats{};
+            if (idle && engine.get_waiting_num() == 0 && engine.get_busy_server_num() == 0)
+            {
+                window_end = max(window_end, time - time % window); // nothing happens before time
+            }
+            window_end += window;
+        }
+    }
+
+    void print_window(int end)
+    {
+        if (current.arrivals == 0 && current.served == 0)
+        {
+            return;
+        }
+        std::cout << "[" << window_end - window << ", " << end << ") arrivals " << current.arrivals << ", served " << current.served;
+        print_percentiles("wait", current.wait);
+        print_percentiles("response", current.response);
+        std::cout << ", waiting " << engine.get_waiting_num() << ", busy " << engine.get_busy_server_num() << "/" << server_num << std::endl;
+    }
+
+    static void print_percentiles(const char *name, std::vector<int> &values)
+    {
+        if (values.empty())
+        {
+            return;
+        }
+        auto percentile = [&values](double p) {
+            size_t k = (size_t)(p * (values.size() - 1));
+            std::nth_element(values.begin(), values.begin() + k, values.end());
+            return values[k];
+        };
+        std::cout << ", " << name << " p50 " << percentile(0.5) << " p99 " << percentile(0.99) << " max " << *std::max_element(values.begin(), values.end());
+    }
+
+    void print_summary()
+    {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_start).count();
+        long long arrivals = arrival_num.load();
+        std::cout << "Stream: " << arrivals << " arrivals, " << served_num << " served, " << late_num << " late, " << bad_line_num.load() << " bad lines in " << seconds << " s ("
+                  << (long long)(arrivals / max(seconds, 1e-9)) << " arrivals/s), the reader waited on a full queue " << stall_num.load() << " times" << std::endl;
+    }
+
+    void read_feed(const std::string &source)
+    {
+        if (source == "-")
+        {
+            read_connection(STDIN_FILENO);
+        }
+        else
+        {
+            serve_socket(source);
+        }
+        channel.Send({}); // an empty batch ends the stream
+    }
+
+    void serve_socket(const std::string &path)
+    {
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (listener < 0 || path.size() >= sizeof(address.sun_path))
+        {
+            std::cerr << "cannot create the socket " << path << std::endl;
+            return;
+        }
+        std::strcpy(address.sun_path, path.c_str());
+        unlink(path.c_str());
+        if (bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 16) != 0)
+        {
+            std::cerr << "cannot listen on " << path << ": " << std::strerror(errno) << std::endl;
+            close(listener);
+            return;
+        }
+        std::cout << "Listening on " << path << std::endl;
+
+        // a signal shuts the sockets down, which wakes the blocked accept or read
+        listener_fd = listener;
+        struct sigaction action{};
+        action.sa_handler = on_signal;
+        sigaction(SIGINT, &action, nullptr);
+        sigaction(SIGTERM, &action, nullptr);
+        while (!stop_requested)
+        {
+            int connection = accept(listener, nullptr, nullptr);
+            if (connection < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                break;
+            }
+            connection_fd = connection;
+            if (stop_requested)
+            {
+                shutdown(connection, SHUT_RD);
+            }
+            read_connection(connection);
+            connection_fd = -1;
+            close(connection);
+        }
+        listener_fd = -1;
+        close(listener);
+        unlink(path.c_str());
+    }
+
+    // lines are parsed in place as they come; a batch is handed over after every read, so a
+    // slow feed is not held back waiting for a full batch
+    void read_connection(int fd)
+    {
+        std::vector<char> buffer(1 << 16);
+        size_t used = 0;
+        std::vector<Arrival> batch;
+        while (true)
+        {
+            if (used == buffer.size())
+            {
+                buffer.resize(buffer.size() * 2); // a line longer than the buffer
+            }
+            ssize_t n = read(fd, buffer.data() + used, buffer.size() - used);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                break;
+            }
+            used += n;
+
+            char *begin = buffer.data();
+            char *end = buffer.data() + used;
+            while (true)
+            {
+                char *newline = std::find(begin, end, '\n');
+                if (newline == end)
+                {
+                    break;
+                }
+                parse_line(begin, newline, batch);
+                begin = newline + 1;
+                if (batch.size() == batch_size)
+                {
+                    hand_over(batch);
+                }
+            }
+            hand_over(batch);
+            used = end - begin;
+            std::memmove(buffer.data(), begin, used);
+        }
+        parse_line(buffer.data(), buffer.data() + used, batch); // a last line without a newline
+        hand_over(batch);
+    }
+
+    void parse_line(const char *begin, const char *end, std::vector<Arrival> &batch)
+    {
+        int fields[4] = {0, 0, 0, 0};
+        int n = 0;
+        const char *p = begin;
+        while (n < 4)
+        {
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+            {
+                p++;
+            }
+            if (p == end)
+            {
+                break;
+            }
+            auto [next, error] = std::from_chars(p, end, fields[n]);
+            if (error != std::errc{})
+            {
+                break;
+            }
+            p = next;
+            n++;
+        }
+        if (n == 0 && p == end)
+        {
+            return; // an empty line
+        }
+        if (n < 3 || fields[1] < 0 || fields[2] < 0 || fields[3] < 0)
+        {
+            bad_line_num++;
+            return;
+        }
+        batch.push_back(Arrival{fields[1], fields[2], fields[3]});
+    }
+
+    void hand_over(std::vector<Arrival> &batch)
+    {
+        if (batch.empty())
+        {
+            return;
+        }
+        arrival_num += batch.size();
+        if (channel.Size() >= channel_capacity)
+        {
+            stall_num++; // the send below blocks until the simulation catches up
+        }
+        channel.Send(std::move(batch));
+        batch = std::vector<Arrival>();
+        batch.reserve(batch_size);
+    }
+
+    static void on_signal(int)
+    {
+        stop_requested = true;
+        int fd = listener_fd;
+        if (fd >= 0)
+        {
+            shutdown(fd, SHUT_RDWR);
+        }
+        fd = connection_fd;
+        if (fd >= 0)
+        {
+            shutdown(fd, SHUT_RD);
+        }
+    }
+
+    static inline std::atomic<bool> stop_requested{false};
+    static inline std::atomic<int> listener_fd{-1};
+    static inline std::atomic<int> connection_fd{-1};
+
+    int server_num;
+    int window;
+    Engine engine;
+    primitives::Channel<std::vector<Arrival>> channel;
+    int channel_capacity;
+    int now = 0;
+    int window_end = window;
+    WindowStats current;
+    long long served_num = 0;
+    long long late_num = 0;
+    std::atomic<long long> arrival_num{0};
+    std::atomic<long long> bad_line_num{0};
+    std::atomic<long long> stall_num{0};
+    std::chrono::steady_clock::time_point wall_start;
+};
+
+#endif // !STREAM_HPP
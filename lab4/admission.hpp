@@ -0,0 +1,294 @@
+#ifndef ADMISSION_HPP
+#define ADMISSION_HPP
+
+#include <cmath>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_map>
+
+enum class admission_policy
+{
+    RMS,
+    EDF
+};
+
+// a periodic task as the admission test sees it
+struct TaskSpec
+{
+    int period;
+    int wcet; // worst-case execution time per job
+    int deadline = 0; // relative deadline, 0 means the period
+};
+
+// Online admission control for periodic tasks on one CPU. Tasks are added and removed at
+// runtime, and "can this task be admitted?" is answered from state that is kept up to date
+// incrementally, without simulating the schedule:
+//   EDF: the utilization (density when deadlines are shorter than periods) must not exceed 1.
+//   RMS: the hyperbolic bound prod(U_i + 1) <= 2 admits quickly. Otherwise the new task and
+//        every task of lower priority must meet their deadlines: a closed-form upper bound of
+//        the response time settles most of them in O(1), and response-time analysis (RTA) the
+//        rest, starting from known lower bounds of their response times.
+// Utilization terms are kept in fixed point and rounded up, so sums never drift.
+class AdmissionController
+{
+public:
+    explicit AdmissionController(admission_policy policy) : policy(policy) {}
+
+    // whether the task could be added now
+    bool query(const TaskSpec &spec)
+    {
+        return check(spec, false);
+    }
+
+    // the id of the admitted task, -1 if it was rejected
+    int add_task(const TaskSpec &spec)
+    {
+        if (!check(spec, true))
+        {
+            return -1;
+        }
+        int id = next_id++;
+        TaskState task{spec.period, spec.wcet, deadline_of(spec), id, candidate_response, utilization_term(spec), log_term(spec)};
+        size_t position = priority_position(spec.period);
+        tasks.insert(tasks.begin() + position, task);
+        for (size_t i = position + 1; i < tasks.size() && policy == admission_policy::RMS; ++i)
+        {
+            tasks[i].response = candidate_responses[i - position - 1];
+        }
+        utilization_sum += task.utilization;
+        log_sum += task.log_utilization;
+        implicit_num += task.deadline >= task.period;
+        positions_dirty = true;
+        return id;
+    }
+
+    bool remove_task(int id)
+    {
+        size_t position = find(id);
+        if (position == tasks.size())
+        {
+            return false;
+        }
+        utilization_sum -= tasks[position].utilization;
+        log_sum -= tasks[position].log_utilization;
+        implicit_num -= tasks[position].deadline >= tasks[position].period;
+        tasks.erase(tasks.begin() + position);
+        // less interference: the response times below are now upper bounds, restart from the job itself
+        for (size_t i = position; i < tasks.size(); ++i)
+        {
+            tasks[i].response = tasks[i].wcet;
+        }
+        positions_dirty = true;
+        return true;
+    }
+
+    size_t size() const
+    {
+        return tasks.size();
+    }
+
+    // the utilization, under EDF the density when deadlines are shorter than periods
+    double utilization() const
+    {
+        return (double)utilization_sum / scale;
+    }
+
+    // a lower bound of the worst-case response time of an RMS task, exact where RTA had to
+    // run; -1 for an unknown id
+    long long response_time(int id)
+    {
+        size_t position = find(id);
+        return position == tasks.size() ? -1 : tasks[position].response;
+    }
+
+private:
+    static constexpr long long scale = 1000000000000LL; // fixed-point one
+
+    struct TaskState
+    {
+        int period;
+        int wcet;
+        int deadline;
+        int id;
+        long long response; // a lower bound of the worst-case response time under RMS
+        long long utilization; // utilization_term in fixed point, rounded up
+        long long log_utilization; // log(1 + C/T) in fixed point, rounded up
+    };
+
+    static int deadline_of(const TaskSpec &spec)
+    {
+        return spec.deadline > 0 ? spec.deadline : spec.period;
+    }
+
+    // C/T, or C/min(T, D) under EDF where the density test covers short deadlines
+    long long utilization_term(const TaskSpec &spec) const
+    {
+        int d = policy == admission_policy::EDF ? std::min(spec.period, deadline_of(spec)) : spec.period;
+        return ((__int128)spec.wcet * scale + d - 1) / d;
+    }
+
+    static long long log_term(const TaskSpec &spec)
+    {
+        return (long long)std::ceil(std::log1p((double)spec.wcet / spec.period) * scale) + 1;
+    }
+
+    // rate monotonic: a shorter period is a higher priority, a new task goes behind equal periods
+    size_t priority_position(int period) const
+    {
+        return std::upper_bound(tasks.begin(), tasks.end(), period, [](int p, const TaskState &t) { return p < t.period; }) - tasks.begin();
+    }
+
+    size_t find(int id)
+    {
+        if (positions_dirty)
+        {
+            positions.clear();
+            for (size_t i = 0; i < tasks.size(); ++i)
+            {
+                positions[tasks[i].id] = i;
+            }
+            positions_dirty = false;
+        }
+        auto it = positions.find(id);
+        return it == positions.end() ? tasks.size() : it->second;
+    }
+
+    // the admission test, keeps the response times it computed for add_task
+    bool check(const TaskSpec &spec, bool keep)
+    {
+        if (spec.period <= 0 || spec.wcet <= 0 || spec.wcet > deadline_of(spec))
+        {
+            return false;
+        }
+        long long u = utilization_term(spec);
+        // every term is rounded up, allow one unit per task of rounding
+        if (utilization_sum + u > scale + (long long)tasks.size() + 1)
+        {
+            return false;
+        }
+        candidate_responses.clear();
+        candidate_response = spec.wcet;
+        if (policy == admission_policy::EDF)
+        {
+            return true;
+        }
+
+        // hyperbolic bound for implicit deadlines, log(prod(1 + U_i)) <= log 2
+        size_t position = priority_position(spec.period);
+        bool implicit = deadline_of(spec) >= spec.period && implicit_num == tasks.size();
+        if (implicit && log_sum + log_term(spec) <= (long long)(std::log(2.0) * scale))
+        {
+            if (keep)
+            {
+                // the stored lower bounds stay valid, just not tight
+                for (size_t i = position; i < tasks.size(); ++i)
+                {
+                    candidate_responses.push_back(tasks[i].response);
+                }
+            }
+            return true;
+        }
+
+        // the new task, then every task it would preempt: the upper bound settles most of them,
+        // response-time analysis the rest
+        Interference higher; // of the tasks above the one being analysed
+        for (size_t j = 0; j < position; ++j)
+        {
+            higher.add(tasks[j].period, tasks[j].wcet);
+        }
+        candidate_response = bound_or_analyse(position, spec.wcet, deadline_of(spec), spec.wcet, nullptr, higher);
+        if (candidate_response < 0)
+        {
+            return false;
+        }
+        higher.add(spec.period, spec.wcet);
+        for (size_t i = position; i < tasks.size(); ++i)
+        {
+            long long r = bound_or_analyse(i, tasks[i].wcet, tasks[i].deadline, tasks[i].response, &spec, higher);
+            if (r < 0)
+            {
+                return false;
+            }
+            candidate_responses.push_back(r);
+            higher.add(tasks[i].period, tasks[i].wcet);
+        }
+        return true;
+    }
+
+    // sums over a set of higher-priority tasks for the closed-form bounds of a response time
+    struct Interference
+    {
+        double utilization = 0; // sum of C_j / T_j
+        double carry = 0; // sum of C_j * (1 - C_j / T_j)
+
+        void add(int period, int wcet)
+        {
+            double u = (double)wcet / period;
+            utilization += u;
+            carry += wcet * (1 - u);
+        }
+    };
+
+    // A lower bound of the response time when the bound (Bini and Buttazzo)
+    //   R <= (C + sum C_j (1 - U_j)) / (1 - sum U_j)
+    // already meets the deadline, otherwise the exact response time, -1 for a miss. The lower
+    // bound keeps the known one, raised to the fluid bound R >= C / (1 - sum U_j).
+    long long bound_or_analyse(size_t count, int wcet, int deadline, long long known, const TaskSpec *extra, const Interference &higher) const
+    {
+        const double margin = 1e-9; // against rounding in the double sums
+        if (higher.utilization < 1 - margin)
+        {
+            double slack = 1 - higher.utilization;
+            long long lower = std::max<long long>(known, (long long)(wcet / slack * (1 - margin)));
+            if ((wcet + higher.carry) / slack * (1 + margin) + 1 <= deadline)
+            {
+                return std::max<long long>(lower, wcet);
+            }
+            known = lower;
+        }
+        return analyse_response(count, wcet, deadline, known, extra);
+    }
+
+    // fixed point of R = C + sum over higher priorities of ceil(R / T_j) * C_j, starting from a
+    // lower bound; the higher priorities are tasks[0, count) plus `extra`; -1 if R exceeds the deadline
+    long long analyse_response(size_t count, int wcet, int deadline, long long start, const TaskSpec *extra) const
+    {
+        long long r = std::max<long long>(start, wcet);
+        while (true)
+        {
+            long long next = wcet;
+            for (size_t j = 0; j < count && next <= deadline; ++j)
+            {
+                next += (r + tasks[j].period - 1) / tasks[j].period * tasks[j].wcet;
+            }
+            if (extra != nullptr)
+            {
+                next += (r + extra->period - 1) / extra->period * extra->wcet;
+            }
+            if (next > deadline)
+            {
+                return -1;
+            }
+            if (next == r)
+            {
+                return r;
+            }
+            r = next;
+        }
+    }
+
+    admission_policy policy;
+    std::vector<TaskState> tasks; // in priority order
+    std::unordered_map<int, size_t> positions; // id -> index in tasks, rebuilt lazily
+    bool positions_dirty = false;
+    long long utilization_sum = 0;
+    long long log_sum = 0;
+    size_t implicit_num = 0; // tasks whose deadline is their period
+    int next_id = 0;
+    long long candidate_response = 0;
+    std::vector<long long> candidate_responses; // for the tasks behind the candidate
+};
+
+#endif // !ADMISSION_HPP
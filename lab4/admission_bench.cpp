@@ -0,0 +1,177 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "admission.hpp"
+
+// admission throughput of the incremental controller against re-checking the whole set
+//
+// usage: ./admission_bench [operations], the operations of a 16-task set, fewer for larger sets
+
+struct AdmittedTask
+{
+    int id;
+    TaskSpec spec;
+    long long order; // admission order, breaks ties between equal periods
+};
+
+// the whole test from scratch: utilization for EDF, full response-time analysis for RMS
+bool check_from_scratch(admission_policy policy, std::vector<AdmittedTask> tasks, const TaskSpec &spec)
+{
+    tasks.push_back({-1, spec, (long long)1 << 62});
+    long double load = 0;
+    for (const AdmittedTask &t : tasks)
+    {
+        int d = t.spec.deadline > 0 ? t.spec.deadline : t.spec.period;
+        load += (long double)t.spec.wcet / (policy == admission_policy::EDF ? std::min(t.spec.period, d) : t.spec.period);
+    }
+    if (load > 1 + 1e-9L)
+    {
+        return false;
+    }
+    if (policy == admission_policy::EDF)
+    {
+        return true;
+    }
+    std::sort(tasks.begin(), tasks.end(), [](const AdmittedTask &a, const AdmittedTask &b) { return a.spec.period != b.spec.period ? a.spec.period < b.spec.period : a.order < b.order; });
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        int deadline = tasks[i].spec.deadline > 0 ? tasks[i].spec.deadline : tasks[i].spec.period;
+        long long r = tasks[i].spec.wcet;
+        while (true)
+        {
+            long long next = tasks[i].spec.wcet;
+            for (size_t j = 0; j < i; ++j)
+            {
+                next += (r + tasks[j].spec.period - 1) / tasks[j].spec.period * tasks[j].spec.wcet;
+            }
+            if (next > deadline)
+            {
+                return false;
+            }
+            if (next == r)
+            {
+                break;
+            }
+            r = next;
+        }
+    }
+    return true;
+}
+
+// log-uniform periods, utilizations around the share of one task in a CPU loaded up to load
+TaskSpec random_task(std::mt19937 &rng, int task_num, double load)
+{
+    std::uniform_real_distribution<double> log_period(std::log(1000.0), std::log(1000000.0));
+    std::uniform_real_distribution<double> share(0.5, 1.5);
+    int period = (int)std::exp(log_period(rng));
+    int wcet = std::max(1, (int)(period * load / task_num * share(rng)));
+    return {period, std::min(wcet, period)};
+}
+
+void bench(admission_policy policy, int task_num, long operations)
+{
+    // the analysis grows with the square of the set, keep the runs of large sets short
+    operations = std::max<long>(200, operations * 16 / task_num);
+    std::mt19937 rng(2023 + task_num);
+    // close to what each test can still admit, so that a good part of the requests is rejected
+    double load = policy == admission_policy::EDF ? 0.98 : 0.85;
+    AdmissionController controller(policy);
+    std::vector<AdmittedTask> admitted;
+    long long order = 0;
+
+    // fill the CPU up to task_num tasks
+    for (int attempt = 0; attempt < task_num * 20 && (int)admitted.size() < task_num; ++attempt)
+    {
+        TaskSpec spec = random_task(rng, task_num, load);
+        int id = controller.add_task(spec);
+        if (id >= 0)
+        {
+            admitted.push_back({id, spec, order++});
+        }
+    }
+
+    // churn at capacity: a task leaves, and a new one asks to be admitted; a rejected request
+    // puts the task that left back
+    std::vector<TaskSpec> arrivals(operations);
+    std::vector<size_t> leaving(operations);
+    for (long i = 0; i < operations; ++i)
+    {
+        arrivals[i] = random_task(rng, task_num, load);
+        leaving[i] = rng();
+    }
+
+    long accepted = 0;
+    long mismatches = 0;
+    long verify_every = std::max<long>(1, operations / 500);
+    double incremental_ns = 0;
+    double scratch_ns = 0;
+    long scratch_num = 0;
+    for (long i = 0; i < operations; ++i)
+    {
+        size_t victim = leaving[i] % admitted.size();
+        AdmittedTask left = admitted[victim];
+        controller.remove_task(left.id);
+        admitted[victim] = admitted.back();
+        admitted.pop_back();
+
+        bool expected = false;
+        if (i % verify_every == 0)
+        {
+            auto begin = std::chrono::steady_clock::now();
+            expected = check_from_scratch(policy, admitted, arrivals[i]);
+            scratch_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+            scratch_num++;
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        int id = controller.add_task(arrivals[i]);
+        incremental_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+        if (i % verify_every == 0 && expected != (id >= 0))
+        {
+            mismatches++;
+        }
+        if (id >= 0)
+        {
+            accepted++;
+            admitted.push_back({id, arrivals[i], order++});
+        }
+        else
+        {
+            int back = controller.add_task(left.spec);
+            if (back >= 0)
+            {
+                admitted.push_back({back, left.spec, order++});
+            }
+        }
+    }
+
+    std::cout << std::left << std::setw(6) << (policy == admission_policy::RMS ? "RMS" : "EDF") << std::setw(8) << task_num << std::right << std::fixed << std::setprecision(3)
+              << std::setw(10) << controller.utilization() << std::setw(10) << (double)accepted / operations
+              << std::setprecision(2) << std::setw(14) << incremental_ns / operations / 1000 << std::setw(14) << scratch_ns / scratch_num / 1000
+              << std::setprecision(0) << std::setw(14) << operations / (incremental_ns / 1e9) << std::setw(10) << mismatches << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    long operations = 100000;
+    if (argc > 1)
+    {
+        operations = std::stol(argv[1]);
+    }
+
+    std::cout << std::left << std::setw(6) << "test" << std::setw(8) << "tasks" << std::right << std::setw(10) << "util" << std::setw(10) << "accept"
+              << std::setw(14) << "incr us/op" << std::setw(14) << "scratch us/op" << std::setw(14) << "admits/s" << std::setw(10) << "mismatch" << std::endl;
+    for (admission_policy policy : {admission_policy::EDF, admission_policy::RMS})
+    {
+        for (int task_num : {16, 128, 1024})
+        {
+            bench(policy, task_num, operations);
+        }
+    }
+}
@@ -0,0 +1,227 @@
+#ifndef CYCLIC_HPP
+#define CYCLIC_HPP
+
+#include <array>
+#include <cstddef>
+#include <numeric>
+#include "event.hpp"
+#include "task.hpp"
+#include "edf.hpp"
+#include "rms.hpp"
+
+// one entry of a cyclic-executive table: job `index` of task `task` runs over [begin, end)
+struct Slot
+{
+    int begin;
+    int end;
+    int task; // position in the task list
+    int index;
+    int in_time; // release of the job
+    bool finishes; // the job completes at end
+};
+
+// the shape of a table: slots [0, prefix_slot_num) cover [0, prefix_length) once, the rest
+// covers one hyperperiod that repeats from prefix_length on
+struct CyclicPlan
+{
+    size_t slot_num = 0;
+    size_t prefix_slot_num = 0;
+    int prefix_length = 0;
+    int hyperperiod = 1;
+};
+
+// Simulates a static periodic task set with the comparator of a strategy (rms_cmp or
+// edf_cmp) until the pending work at two consecutive hyperperiod boundaries after the
+// largest offset is the same, which makes the schedule repeat from the first of them. The
+// slots are written to `out` unless it is null, so a first call can size the table. The
+// set must be periodic and meet every deadline; otherwise the evaluation throws, which
+// fails compilation when it runs at compile time.
+template <typename Compare, size_t N>
+constexpr CyclicPlan plan_cyclic(const std::array<Task, N> &tasks, Slot *out)
+{
+    constexpr int max_boundaries = 8;
+    CyclicPlan plan;
+    int offset = 0;
+    for (const Task &task : tasks)
+    {
+        if (!task.is_cycle || task.period_or_stop_time <= 0 || task.run_time <= 0)
+        {
+            throw "a cyclic table needs periodic tasks";
+        }
+        plan.hyperperiod = std::lcm(plan.hyperperiod, task.period_or_stop_time);
+        offset = std::max(offset, task.in_time);
+    }
+
+    // the job of each task that is pending, if remaining > 0
+    std::array<Event, N> jobs{};
+    std::array<int, N> remaining{};
+    std::array<int, N> next_release{};
+    std::array<int, N> job_count{};
+    std::array<int, N> last_state{}; // remaining work at the previous boundary
+    for (size_t i = 0; i < N; ++i)
+    {
+        next_release[i] = tasks[i].in_time;
+    }
+
+    Compare compare;
+    int running = -1;
+    int running_index = -1;
+    int last_running = -1;
+    int boundary_num = 0;
+    size_t slot_num = 0;
+    size_t last_boundary_slot = 0;
+    int t = 0;
+    while (true)
+    {
+        // a boundary: the state is the remaining work of every task (releases are periodic)
+        if (t >= offset && (t - offset) % plan.hyperperiod == 0 && t > offset)
+        {
+            // and the job that ran last, which wins ties
+            bool same = boundary_num > 0 && last_running == running;
+            for (size_t i = 0; i < N; ++i)
+            {
+                same = same && last_state[i] == remaining[i];
+                last_state[i] = remaining[i];
+            }
+            last_running = running;
+            if (same)
+            {
+                plan.slot_num = slot_num;
+                plan.prefix_slot_num = last_boundary_slot;
+                plan.prefix_length = t - plan.hyperperiod;
+                return plan;
+            }
+            if (++boundary_num == max_boundaries)
+            {
+                throw "the schedule does not repeat";
+            }
+            last_boundary_slot = slot_num;
+        }
+
+        for (size_t i = 0; i < N; ++i)
+        {
+            if (next_release[i] == t)
+            {
+                if (remaining[i] > 0)
+                {
+                    throw "a deadline is missed";
+                }
+                int period = tasks[i].period_or_stop_time;
+                jobs[i] = Event{index : job_count[i]++, in_time : t, total_run_time : tasks[i].run_time, stop_time : t + period, event_name : tasks[i].event_name, time_pointer : 0, priority : 1000 / period, laxity : 0};
+                remaining[i] = tasks[i].run_time;
+                next_release[i] += period;
+            }
+        }
+
+        // the running job keeps the CPU unless another one strictly ranks above it; as in the
+        // strategies, a job in its last tick is not preempted
+        int best = running >= 0 && remaining[running] > 0 ? running : -1;
+        for (size_t i = 0; i < N && !(best >= 0 && best == running && remaining[best] == 1); ++i)
+        {
+            if (remaining[i] > 0 && (best < 0 || compare(jobs[best], jobs[i])))
+            {
+                best = i;
+            }
+        }
+
+        // run up to the next release, completion or boundary
+        int until = t + (best >= 0 ? remaining[best] : plan.hyperperiod);
+        for (size_t i = 0; i < N; ++i)
+        {
+            until = std::min(until, next_release[i]);
+        }
+        if (t >= offset)
+        {
+            until = std::min(until, t + plan.hyperperiod - (t - offset) % plan.hyperperiod);
+        }
+        else
+        {
+            until = std::min(until, offset + plan.hyperperiod);
+        }
+
+        if (best >= 0)
+        {
+            // the same job going on extends its slot, except across a boundary
+            bool extend = slot_num > last_boundary_slot && running == best && running_index == jobs[best].index;
+            remaining[best] -= until - t;
+            if (!extend)
+            {
+                slot_num++;
+            }
+            if (out != nullptr)
+            {
+                Slot &slot = out[slot_num - 1];
+                if (!extend)
+                {
+                    slot = Slot{t, until, best, jobs[best].index, jobs[best].in_time, false};
+                }
+                slot.end = until;
+                slot.finishes = remaining[best] == 0;
+            }
+            running_index = jobs[best].index;
+        }
+        running = best;
+        t = until;
+    }
+}
+
+// a table built at compile time: CyclicTable<tasks, edf_cmp>::slots, tasks being a constexpr
+// std::array<Task, N>
+template <auto tasks, typename Compare>
+struct CyclicTable
+{
+    static constexpr CyclicPlan plan = plan_cyclic<Compare>(tasks, nullptr);
+
+    static constexpr std::array<Slot, plan.slot_num> slots = []() {
+        std::array<Slot, plan.slot_num> table{};
+        plan_cyclic<Compare>(tasks, table.data());
+        return table;
+    }();
+
+    // how far the job indices of a task move per hyperperiod
+    static constexpr std::array<int, tasks.size()> jobs_per_cycle = []() {
+        std::array<int, tasks.size()> count{};
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            count[i] = plan.hyperperiod / tasks[i].period_or_stop_time;
+        }
+        return count;
+    }();
+};
+
+// The whole runtime scheduler of a static set: replays the prefix once and then the cycle,
+// calling body(task, index, begin, end, finishes) for every slot that starts before
+// total_time (the last one may end after it). Returns the slots dispatched.
+template <typename Table, typename Body>
+long long dispatch_cyclic(int total_time, Body &&body)
+{
+    constexpr const auto &slots = Table::slots;
+    constexpr CyclicPlan plan = Table::plan;
+    long long dispatched = 0;
+    for (size_t s = 0; s < plan.prefix_slot_num; ++s)
+    {
+        const Slot &slot = slots[s];
+        if (slot.begin >= total_time)
+        {
+            return dispatched;
+        }
+        body(slot.task, slot.index, slot.begin, slot.end, slot.finishes);
+        dispatched++;
+    }
+    for (long long cycle = 0;; ++cycle)
+    {
+        long long shift = cycle * plan.hyperperiod;
+        for (size_t s = plan.prefix_slot_num; s < plan.slot_num; ++s)
+        {
+            const Slot &slot = slots[s];
+            if (slot.begin + shift >= total_time)
+            {
+                return dispatched;
+            }
+            body(slot.task, slot.index + (int)(cycle * Table::jobs_per_cycle[slot.task]), (int)(slot.begin + shift), (int)(slot.end + shift), slot.finishes);
+            dispatched++;
+        }
+    }
+}
+
+#endif // !CYCLIC_HPP
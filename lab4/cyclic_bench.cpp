@@ -0,0 +1,107 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <tuple>
+
+#include "cyclic.hpp"
+#include "strategy.hpp"
+
+// per-dispatch cost of a compile-time cyclic table against simulating the same static set
+// with Strategy::run, checking that both give the same schedule up to total_time (later
+// releases, which the simulation leaves out, change what comes after it)
+//
+// usage: ./cyclic_bench [total_time]
+
+constexpr std::array<Task, 4> small_set{{
+    {'A', true, 0, 20, 5},
+    {'B', true, 0, 50, 10},
+    {'C', true, 0, 100, 20},
+    {'D', true, 5, 40, 6},
+}};
+
+constexpr std::array<Task, 8> large_set{{
+    {'A', true, 0, 10, 1},
+    {'B', true, 0, 15, 2},
+    {'C', true, 3, 20, 2},
+    {'D', true, 0, 30, 3},
+    {'E', true, 7, 40, 4},
+    {'F', true, 0, 60, 6},
+    {'G', true, 11, 120, 9},
+    {'H', true, 0, 240, 20},
+}};
+
+using segment = std::tuple<int, int, char, int>; // begin, end, task, job
+
+// segments of the same job back to back are one, empty ones are dropped; only [0, limit) is kept
+void append(std::vector<segment> &segments, int begin, int end, char name, int index, int limit)
+{
+    end = std::min(end, limit);
+    if (begin >= end)
+    {
+        return;
+    }
+    if (!segments.empty())
+    {
+        auto &[last_begin, last_end, last_name, last_index] = segments.back();
+        if (last_end == begin && last_name == name && last_index == index)
+        {
+            last_end = end;
+            return;
+        }
+    }
+    segments.emplace_back(begin, end, name, index);
+}
+
+template <auto tasks, typename Compare, typename RuntimeStrategy>
+void bench(const char *set_name, const char *policy_name, int total_time)
+{
+    using Table = CyclicTable<tasks, Compare>;
+    std::vector<Task> task_list(tasks.begin(), tasks.end());
+
+    // the runtime scheduler, the job set built beforehand
+    JobSet jobs(task_list, total_time);
+    RuntimeStrategy strategy;
+    auto begin = std::chrono::steady_clock::now();
+    result_pair result = strategy.run(jobs, total_time);
+    double runtime_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    // the table, with a body that does next to nothing
+    long long checksum = 0;
+    begin = std::chrono::steady_clock::now();
+    long long dispatched = dispatch_cyclic<Table>(total_time, [&checksum](int task, int index, int slot_begin, int slot_end, bool finishes) {
+        checksum += task + index + slot_end - slot_begin + finishes;
+    });
+    double table_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+
+    std::vector<segment> expected;
+    for (const Result &r : result.first)
+    {
+        append(expected, r.response_begin_time, r.response_end_time, r.event_name, r.index, total_time);
+    }
+    std::vector<segment> replayed;
+    dispatch_cyclic<Table>(total_time, [&replayed, total_time](int task, int index, int slot_begin, int slot_end, bool) {
+        append(replayed, slot_begin, slot_end, tasks[task].event_name, index, total_time);
+    });
+
+    std::cout << std::left << std::setw(8) << set_name << std::setw(6) << policy_name << std::right << std::setw(8) << Table::plan.slot_num << std::setw(8) << Table::plan.hyperperiod
+              << std::setw(12) << dispatched << std::fixed << std::setprecision(2) << std::setw(14) << runtime_ns / std::max<size_t>(result.first.size(), 1)
+              << std::setw(14) << table_ns / std::max(dispatched, 1LL) << std::setw(10) << (result.second && expected == replayed ? "yes" : "NO") << std::endl;
+    if (checksum == -1)
+    {
+        std::cout << checksum << std::endl; // keeps the dispatch loop from being optimized away
+    }
+}
+
+int main(int argc, char **argv)
+{
+    int total_time = argc > 1 ? std::atoi(argv[1]) : 10000000;
+
+    std::cout << std::left << std::setw(8) << "set" << std::setw(6) << "test" << std::right << std::setw(8) << "slots" << std::setw(8) << "cycle"
+              << std::setw(12) << "dispatches" << std::setw(14) << "run ns/seg" << std::setw(14) << "table ns/seg" << std::setw(10) << "same" << std::endl;
+    bench<small_set, rms_cmp, RMS>("small", "RMS", total_time);
+    bench<small_set, edf_cmp, EDF>("small", "EDF", total_time);
+    bench<large_set, rms_cmp, RMS>("large", "RMS", total_time);
+    bench<large_set, edf_cmp, EDF>("large", "EDF", total_time);
+}
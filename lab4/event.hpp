@@ -14,6 +14,8 @@ struct Event
 
     int priority; // only for RMS
     int laxity; // only for LLF
+    int overhead = 0; // switching work charged to the job and not done yet
+    bool is_cycle = true; // false for the job of an aperiodic task
 
     bool operator < (const Event &b) const
     {
@@ -0,0 +1,323 @@
+#ifndef EXECUTOR_HPP
+#define EXECUTOR_HPP
+
+#include <map>
+#include <limits>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <utility>
+#include <exception>
+#include <coroutine>
+#include <functional>
+#include <pthread.h>
+#include "event.hpp"
+#include "task.hpp"
+#include "edf.hpp"
+#include "llf.hpp"
+#include "rms.hpp"
+#include "../common/trace.hpp"
+
+using executor_clock = std::chrono::steady_clock;
+
+// A preemption point inside a job body: `co_await yield_point();` gives the CPU back to the
+// executor only when a release is due, otherwise it costs one clock read.
+struct YieldPoint
+{
+    // the next release of the executor running on this thread
+    static inline thread_local executor_clock::time_point next_release = executor_clock::time_point::max();
+
+    bool await_ready() const noexcept
+    {
+        return executor_clock::now() < next_release;
+    }
+    void await_suspend(std::coroutine_handle<>) const noexcept {}
+    void await_resume() const noexcept {}
+};
+
+inline YieldPoint yield_point()
+{
+    return {};
+}
+
+// The coroutine of one job. It starts suspended, and the executor resumes it until it is done.
+class JobBody
+{
+public:
+    struct promise_type
+    {
+        JobBody get_return_object()
+        {
+            return JobBody(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept
+        {
+            return {};
+        }
+        std::suspend_always final_suspend() noexcept
+        {
+            return {};
+        }
+        void return_void() {}
+        void unhandled_exception()
+        {
+            exception = std::current_exception();
+        }
+
+        std::exception_ptr exception;
+    };
+
+    JobBody() {}
+    JobBody(const JobBody &) = delete;
+    JobBody &operator=(const JobBody &) = delete;
+    JobBody(JobBody &&other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    JobBody &operator=(JobBody &&other) noexcept
+    {
+        std::swap(handle, other.handle);
+        return *this;
+    }
+    ~JobBody()
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+
+    // run up to the next preemption point; true once the job is done
+    bool resume()
+    {
+        handle.resume();
+        if (handle.promise().exception)
+        {
+            std::rethrow_exception(handle.promise().exception);
+        }
+        return handle.done();
+    }
+
+private:
+    explicit JobBody(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// what one job did, times in nanoseconds from the start of the run
+struct JobRecord
+{
+    char event_name;
+    int index;
+    long long release;
+    long long deadline;
+    long long start; // first dispatch
+    long long finish;
+    int preemptions;
+
+    long long latency() const
+    {
+        return finish - release;
+    }
+    bool met_deadline() const
+    {
+        return finish <= deadline;
+    }
+};
+
+// Runs periodic and aperiodic jobs for real on one worker thread, in the order the simulated
+// strategy of the same comparator (rms_cmp, edf_cmp, llf_cmp) would pick them. One time unit
+// of the task model is `tick` of wall time; jobs are released by the clock, and a running job
+// is preempted at its next yield point after a release. No real-time scheduling class is
+// needed, the worker is only pinned to a CPU when asked.
+template <typename Compare>
+class Executor
+{
+public:
+    using body_factory = std::function<JobBody(const Event &)>;
+
+    explicit Executor(executor_clock::duration tick) : tick(tick) {}
+
+    // job bodies per task, a coroutine or a callback that runs to completion
+    void set_body(char event_name, body_factory factory)
+    {
+        bodies[event_name] = std::move(factory);
+    }
+
+    void set_callback(char event_name, std::function<void(const Event &)> callback)
+    {
+        bodies[event_name] = [callback](const Event &job) { return run_callback(callback, job); };
+    }
+
+    // the CPU of the worker, -1 to let the OS place it
+    void pin(int new_cpu)
+    {
+        cpu = new_cpu;
+    }
+
+    // run segments in microseconds on a worker lane of this trace
+    void set_trace(tracing::TraceRecorder *new_trace)
+    {
+        trace = new_trace;
+    }
+
+    // whether the worker could be pinned in the last run
+    bool is_pinned() const
+    {
+        return pinned;
+    }
+
+    // runs the jobs released up to total_time on the worker and waits for all of them to finish
+    std::vector<JobRecord> run(const JobSet &jobs, int total_time)
+    {
+        std::vector<JobRecord> records;
+        std::exception_ptr error;
+        std::thread worker([&]() {
+            try
+            {
+                pinned = cpu >= 0 && pin_current_thread(cpu);
+                records = work(jobs, jobs.count_until(total_time));
+            }
+            catch (...)
+            {
+                error = std::current_exception();
+            }
+            YieldPoint::next_release = executor_clock::time_point::max();
+        });
+        worker.join();
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+        return records;
+    }
+
+private:
+    struct ReadyJob
+    {
+        Event event; // time_pointer counts the ticks the job has run
+        JobBody body;
+        size_t record; // index in the records
+        executor_clock::duration ran{0};
+    };
+
+    static JobBody run_callback(std::function<void(const Event &)> callback, Event job)
+    {
+        callback(job);
+        co_return;
+    }
+
+    static bool pin_current_thread(int cpu)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+    }
+
+    std::vector<JobRecord> work(const JobSet &jobs, size_t job_num)
+    {
+        std::vector<JobRecord> records;
+        records.reserve(job_num);
+        std::vector<ReadyJob> ready;
+        if (trace)
+        {
+            trace->set_lane_name(0, 0, "worker");
+        }
+
+        executor_clock::time_point epoch = executor_clock::now();
+        auto at = [&](int time) { return epoch + time * tick; };
+        auto since_epoch = [&](executor_clock::time_point t) { return (long long)std::chrono::duration_cast<std::chrono::nanoseconds>(t - epoch).count(); };
+
+        size_t next_job = 0;
+        int running = -1; // the job that ran last, to count preemptions
+        while (next_job < job_num || !ready.empty())
+        {
+            executor_clock::time_point now = executor_clock::now();
+            while (next_job < job_num && at(jobs[next_job].in_time) <= now)
+            {
+                const Event &job = jobs[next_job++];
+                auto body = bodies.find(job.event_name);
+                if (body == bodies.end())
+                {
+                    continue; // a task without a body has nothing to run
+                }
+                records.push_back(JobRecord{job.event_name, job.index, since_epoch(at(job.in_time)), since_epoch(at(job.stop_time)), -1, -1, 0});
+                ready.push_back(ReadyJob{job, body->second(job), records.size() - 1});
+            }
+            YieldPoint::next_release = next_job < job_num ? at(jobs[next_job].in_time) : executor_clock::time_point::max();
+
+            if (ready.empty())
+            {
+                std::this_thread::sleep_until(YieldPoint::next_release);
+                continue;
+            }
+
+            // the comparator says whether its first job ranks below the second; on a tie the job
+            // that ran last keeps the CPU
+            int current_tick = (now - epoch) / tick;
+            size_t best = 0;
+            for (size_t i = 0; i < ready.size(); ++i)
+            {
+                Event &e = ready[i].event;
+                e.laxity = e.stop_time - current_tick - std::max(e.total_run_time - e.time_pointer, 0);
+                if ((int)ready[i].record == running)
+                {
+                    best = i;
+                }
+            }
+            for (size_t i = 0; i < ready.size(); ++i)
+            {
+                if (compare(ready[best].event, ready[i].event))
+                {
+                    best = i;
+                }
+            }
+
+            ReadyJob &job = ready[best];
+            JobRecord &record = records[job.record];
+            if (running >= 0 && running != (int)job.record && records[running].finish < 0)
+            {
+                records[running].preemptions++;
+            }
+            running = job.record;
+            if (record.start < 0)
+            {
+                record.start = since_epoch(now);
+            }
+
+            bool done = job.body.resume();
+            executor_clock::time_point end = executor_clock::now();
+            job.ran += end - now;
+            job.event.time_pointer = job.ran / tick;
+            if (trace)
+            {
+                trace->complete(0, 0, since_epoch(now) / 1000, since_epoch(end) / 1000, task_name(job.event.event_name), job.event.index);
+            }
+            if (done)
+            {
+                record.finish = since_epoch(end);
+                ready[best] = std::move(ready.back());
+                ready.pop_back();
+            }
+        }
+        return records;
+    }
+
+    const char *task_name(char event_name)
+    {
+        const char *&name = task_names[(unsigned char)event_name];
+        if (name == nullptr)
+        {
+            name = trace->intern(std::string(1, event_name));
+        }
+        return name;
+    }
+
+    executor_clock::duration tick;
+    Compare compare;
+    std::map<char, body_factory> bodies;
+    int cpu = -1;
+    bool pinned = false;
+    tracing::TraceRecorder *trace = nullptr;
+    const char *task_names[256] = {};
+};
+
+#endif // !EXECUTOR_HPP
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include "executor.hpp"
+
+// Runs the tasks of test.txt for real: every job busy-works for its run time, with a
+// preemption point every 50 us, and the latencies from release to completion are printed.
+//
+// usage: ./executor_demo [ RMS(1) | EDF(2) | LLF(3) ] [tick_us] [cpu] [trace.json]
+
+// a job body that burns its run time on the CPU, counting only the time it actually runs
+JobBody spin(Event job, executor_clock::duration tick)
+{
+    const executor_clock::duration slice = std::chrono::microseconds(50);
+    executor_clock::duration left = job.total_run_time * tick;
+    while (left > executor_clock::duration::zero())
+    {
+        auto begin = executor_clock::now();
+        while (executor_clock::now() - begin < std::min(left, slice))
+        {
+        }
+        left -= executor_clock::now() - begin;
+        co_await yield_point();
+    }
+}
+
+template <typename Compare>
+std::vector<JobRecord> execute(const JobSet &jobs, const std::vector<Task> &tasks, int total_time, executor_clock::duration tick, int cpu, tracing::TraceRecorder *trace)
+{
+    Executor<Compare> executor(tick);
+    for (const Task &task : tasks)
+    {
+        executor.set_body(task.event_name, [tick](const Event &job) { return spin(job, tick); });
+    }
+    executor.pin(cpu);
+    executor.set_trace(trace);
+    std::vector<JobRecord> records = executor.run(jobs, total_time);
+    if (cpu >= 0 && !executor.is_pinned())
+    {
+        std::cout << "could not pin the worker to CPU " << cpu << std::endl;
+    }
+    return records;
+}
+
+int main(int argc, char **argv)
+{
+    int method = argc > 1 ? std::atoi(argv[1]) : 2;
+    int tick_us = argc > 2 ? std::atoi(argv[2]) : 1000;
+    int cpu = argc > 3 ? std::atoi(argv[3]) : -1;
+
+    char event_name = 'A';
+    int index, is_cycle, in_time, period_or_stop_time, run_time, total_time;
+    std::ifstream infile("test.txt");
+    infile >> total_time;
+    std::vector<Task> tasks;
+    while (infile >> index >> is_cycle >> in_time >> period_or_stop_time >> run_time)
+    {
+        tasks.push_back(Task{event_name : event_name, is_cycle : is_cycle != 0, in_time : in_time, period_or_stop_time : period_or_stop_time, run_time : run_time});
+        event_name++;
+    }
+
+    JobSet jobs(tasks, total_time);
+    executor_clock::duration tick = std::chrono::microseconds(tick_us);
+    tracing::TraceRecorder trace; // in microseconds
+    tracing::TraceRecorder *trace_pointer = argc > 4 ? &trace : nullptr;
+    std::vector<JobRecord> records;
+    if (method == 1)
+    {
+        records = execute<rms_cmp>(jobs, tasks, total_time, tick, cpu, trace_pointer);
+    }
+    else if (method == 3)
+    {
+        records = execute<llf_cmp>(jobs, tasks, total_time, tick, cpu, trace_pointer);
+    }
+    else
+    {
+        records = execute<edf_cmp>(jobs, tasks, total_time, tick, cpu, trace_pointer);
+    }
+    std::cout << "method: " << (method == 1 ? "RMS" : method == 3 ? "LLF" : "EDF") << ", tick " << tick_us << " us" << std::endl;
+
+    struct Summary
+    {
+        int jobs = 0;
+        int misses = 0;
+        int preemptions = 0;
+        double total_latency = 0;
+        double max_latency = 0;
+    };
+    std::map<char, Summary> summaries;
+    for (const JobRecord &record : records)
+    {
+        Summary &s = summaries[record.event_name];
+        double latency = record.latency() / 1000.0;
+        s.jobs++;
+        s.misses += !record.met_deadline();
+        s.preemptions += record.preemptions;
+        s.total_latency += latency;
+        s.max_latency = std::max(s.max_latency, latency);
+    }
+
+    std::cout << std::left << std::setw(6) << "task" << std::right << std::setw(8) << "jobs" << std::setw(8) << "misses" << std::setw(13) << "preemptions"
+              << std::setw(18) << "mean latency(us)" << std::setw(17) << "max latency(us)" << std::endl;
+    for (auto &[name, s] : summaries)
+    {
+        std::cout << std::left << std::setw(6) << name << std::right << std::setw(8) << s.jobs << std::setw(8) << s.misses << std::setw(13) << s.preemptions
+                  << std::fixed << std::setprecision(1) << std::setw(18) << s.total_latency / s.jobs << std::setw(17) << s.max_latency << std::endl;
+    }
+
+    if (argc > 4)
+    {
+        trace.flush(argv[4]);
+    }
+}
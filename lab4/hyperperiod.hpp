@@ -0,0 +1,398 @@
+#ifndef HYPERPERIOD_HPP
+#define HYPERPERIOD_HPP
+
+#include <map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <functional>
+#include "result.hpp"
+#include "strategy.hpp"
+#include "task.hpp"
+
+// a segment moved by a number of hyperperiods, job indices move along
+inline Result shift_result(Result result, long long cycles, int hyperperiod, const std::map<char, int> &periods)
+{
+    if (cycles == 0)
+    {
+        return result;
+    }
+    int delta = cycles * hyperperiod;
+    result.index += cycles * (hyperperiod / periods.at(result.event_name));
+    result.in_time += delta;
+    result.stop_time += delta;
+    result.response_begin_time += delta;
+    result.response_end_time += delta;
+    return result;
+}
+
+// per-task numbers of a schedule
+struct TaskStatistics
+{
+    long long jobs = 0;
+    long long preemptions = 0;
+    long long total_response = 0;
+    int max_response = 0;
+    long long overhead = 0; // ticks spent on switching to the task's jobs
+    long long late = 0; // jobs that finished after their deadline
+    long long total_lateness = 0;
+    int max_lateness = 0;
+    long long dropped = 0; // jobs dropped by the overload policy
+};
+
+// A schedule made of a simulated prefix, one steady-state hyperperiod repeated window_repeat
+// times, and a simulated tail shifted behind the repeats. Without extrapolation everything is
+// in the prefix.
+struct PeriodicSchedule
+{
+    bool succeed = true;
+    int fail_time = -1; // when the first deadline was missed
+    bool extrapolated = false;
+    int hyperperiod = 0;
+    int simulated_time = 0; // the horizon that was actually simulated
+    long long window_repeat = 0;
+    std::vector<Result> prefix;
+    std::vector<Result> window; // repeat r is shifted by r hyperperiods
+    std::vector<Result> tail; // already shifted by window_repeat hyperperiods
+    std::map<char, int> periods;
+    std::vector<DroppedJob> dropped; // a run with misses is never extrapolated
+
+    long long segment_num() const
+    {
+        return prefix.size() + window.size() * window_repeat + tail.size();
+    }
+
+    Result shifted(const Result &result, long long cycles) const
+    {
+        return shift_result(result, cycles, hyperperiod, periods);
+    }
+
+    // the full list of segments, at most limit of them
+    std::vector<Result> expand(long long limit) const
+    {
+        std::vector<Result> results;
+        results.reserve(std::min(segment_num(), limit));
+        for (const Result &result : prefix)
+        {
+            if ((long long)results.size() >= limit) return results;
+            results.push_back(result);
+        }
+        for (long long r = 1; r <= window_repeat; ++r)
+        {
+            for (const Result &result : window)
+            {
+                if ((long long)results.size() >= limit) return results;
+                results.push_back(shifted(result, r));
+            }
+        }
+        for (const Result &result : tail)
+        {
+            if ((long long)results.size() >= limit) return results;
+            results.push_back(result);
+        }
+        return results;
+    }
+
+    // counted without expanding, every repeat of the window contributes the same numbers
+    std::map<char, TaskStatistics> statistics() const
+    {
+        std::map<char, TaskStatistics> stats;
+        auto add = [&stats](const std::vector<Result> &results, long long weight) {
+            for (const Result &result : results)
+            {
+                TaskStatistics &s = stats[result.event_name];
+                s.overhead += result.overhead * weight;
+                if (result.is_interrupted)
+                {
+                    s.preemptions += weight;
+                    continue;
+                }
+                int response = result.response_end_time - result.in_time;
+                s.jobs += weight;
+                s.total_response += response * weight;
+                s.max_response = std::max(s.max_response, response);
+                int lateness = result.response_end_time - result.stop_time;
+                if (lateness > 0)
+                {
+                    s.late += weight;
+                    s.total_lateness += lateness * weight;
+                    s.max_lateness = std::max(s.max_lateness, lateness);
+                }
+            }
+        };
+        add(prefix, 1);
+        add(window, window_repeat);
+        add(tail, 1);
+        for (const DroppedJob &job : dropped)
+        {
+            stats[job.event_name].dropped++;
+        }
+        return stats;
+    }
+
+    // how many jobs finished how late, for the jobs that finished after their deadline
+    std::map<int, long long> lateness_histogram() const
+    {
+        std::map<int, long long> histogram;
+        auto add = [&histogram](const std::vector<Result> &results, long long weight) {
+            for (const Result &result : results)
+            {
+                if (!result.is_interrupted && result.response_end_time > result.stop_time)
+                {
+                    histogram[result.response_end_time - result.stop_time] += weight;
+                }
+            }
+        };
+        add(prefix, 1);
+        add(window, window_repeat);
+        add(tail, 1);
+        return histogram;
+    }
+};
+
+// Runs a strategy on a task set. A purely periodic set repeats its schedule every hyperperiod
+// (the LCM of the periods) once the start-up transient is over, so only the first few
+// hyperperiods and the last one are simulated: the run is cut at total_time - k * hyperperiod,
+// the pending work at hyperperiod boundaries is compared to find where the schedule recurs, and
+// the k skipped hyperperiods are filled in with copies of the recurring one.
+class HyperperiodRunner
+{
+public:
+    // jobs, if given, is a shared job set of at least plan_horizon() to read instead of building one
+    HyperperiodRunner(std::function<Strategy *()> make_strategy, const std::vector<Task> &tasks, std::shared_ptr<const JobSet> jobs = nullptr, tracing::TraceRecorder *trace = nullptr) : make_strategy(make_strategy), tasks(tasks), jobs(jobs), trace(trace) {}
+
+    // the horizon the first simulation of run(total_time) goes to
+    static int plan_horizon(const std::vector<Task> &tasks, int total_time)
+    {
+        long long hyperperiod, skip;
+        int offset;
+        plan(tasks, total_time, hyperperiod, offset, skip);
+        return total_time - skip * hyperperiod;
+    }
+
+    PeriodicSchedule run(int total_time)
+    {
+        PeriodicSchedule schedule;
+        for (const Task &task : tasks)
+        {
+            if (task.is_cycle)
+            {
+                schedule.periods[task.event_name] = task.period_or_stop_time;
+            }
+        }
+
+        long long hyperperiod, skip;
+        int offset;
+        plan(tasks, total_time, hyperperiod, offset, skip);
+        if (skip < 1)
+        {
+            simulate(total_time, schedule);
+            return schedule;
+        }
+        int horizon = total_time - skip * hyperperiod;
+        std::vector<Result> results = simulate(horizon, schedule);
+        if (!schedule.succeed)
+        {
+            if (!stopped || failed_at > horizon)
+            {
+                // a run that goes on past misses has no steady state to rely on, and a miss
+                // behind the cut might not happen in the full run: simulate everything
+                simulate(total_time, schedule);
+            }
+            return schedule;
+        }
+
+        for (int j = 0; j < 2; ++j)
+        {
+            int boundary = offset + (j + 1) * hyperperiod;
+            if (!recurs(results, offset + j * hyperperiod, hyperperiod, horizon, schedule))
+            {
+                continue;
+            }
+            schedule.extrapolated = true;
+            schedule.hyperperiod = hyperperiod;
+            schedule.window_repeat = skip;
+            schedule.prefix.clear();
+            for (const Result &result : results)
+            {
+                if (result.response_begin_time < boundary)
+                {
+                    schedule.prefix.push_back(result);
+                }
+                if (result.response_begin_time >= boundary - hyperperiod && result.response_begin_time < boundary)
+                {
+                    schedule.window.push_back(result);
+                }
+                if (result.response_begin_time >= boundary)
+                {
+                    schedule.tail.push_back(schedule.shifted(result, skip));
+                }
+            }
+            return schedule;
+        }
+
+        // no recurrence within the simulated hyperperiods
+        simulate(total_time, schedule);
+        return schedule;
+    }
+
+private:
+    // skip is the number of whole hyperperiods that need not be simulated, 0 if the set is not periodic
+    static void plan(const std::vector<Task> &tasks, int total_time, long long &hyperperiod, int &offset, long long &skip)
+    {
+        // a steady state exists only without aperiodic tasks
+        hyperperiod = 1;
+        offset = 0;
+        bool periodic = !tasks.empty();
+        for (const Task &task : tasks)
+        {
+            if (!task.is_cycle || task.period_or_stop_time <= 0)
+            {
+                periodic = false;
+                break;
+            }
+            hyperperiod = std::lcm(hyperperiod, (long long)task.period_or_stop_time);
+            offset = std::max(offset, task.in_time);
+            if (hyperperiod > total_time)
+            {
+                periodic = false;
+                break;
+            }
+        }
+
+        // keep at least the transient and three hyperperiods, skip whole hyperperiods of the rest
+        skip = periodic ? (total_time - offset - 3 * hyperperiod) / hyperperiod : 0;
+        if (skip < 1)
+        {
+            skip = 0;
+        }
+    }
+
+    using job_state = std::tuple<char, int, int, int>; // (task, release relative to the boundary, work done, dispatches)
+
+    std::vector<Result> simulate(int horizon, PeriodicSchedule &schedule)
+    {
+        std::shared_ptr<const JobSet> set = jobs;
+        if (!set || set->get_horizon() < horizon)
+        {
+            set = std::make_shared<const JobSet>(tasks, horizon);
+        }
+        Strategy *strategy = make_strategy();
+        if (trace)
+        {
+            trace->clear();
+            strategy->set_trace(trace);
+        }
+        result_pair result = strategy->run(*set, horizon);
+        failed_at = strategy->get_fail_time();
+        stopped = strategy->stops_on_miss();
+        schedule.dropped = strategy->get_dropped();
+        delete strategy;
+
+        schedule.succeed = result.second;
+        schedule.fail_time = failed_at;
+        schedule.simulated_time = horizon;
+        schedule.prefix = result.first;
+        return result.first;
+    }
+
+    // unfinished jobs at the boundary and the job running across it; with switch costs the work
+    // a job still owes depends on how often it was dispatched, so that is part of its state
+    std::pair<std::vector<job_state>, job_state> state_at(const std::vector<Result> &results, int boundary) const
+    {
+        struct Progress
+        {
+            int executed = 0;
+            int dispatches = 0;
+            bool finished = false;
+        };
+        std::map<std::pair<char, int>, Progress> progress;
+        job_state running{0, 0, 0, 0};
+        for (const Result &result : results)
+        {
+            if (result.response_begin_time >= boundary)
+            {
+                continue;
+            }
+            Progress &p = progress[{result.event_name, result.index}];
+            p.executed += std::min(result.response_end_time, boundary) - result.response_begin_time;
+            p.dispatches++;
+            p.finished = !result.is_interrupted && result.response_end_time <= boundary;
+            if (result.response_end_time > boundary)
+            {
+                running = job_state{result.event_name, result.in_time - boundary, 0, 0};
+            }
+        }
+
+        std::vector<job_state> pending;
+        for (const Task &task : tasks)
+        {
+            for (int i = 0; task.in_time + (long long)i * task.period_or_stop_time < boundary; ++i)
+            {
+                int in_time = task.in_time + i * task.period_or_stop_time;
+                auto it = progress.find({task.event_name, i});
+                Progress p = it == progress.end() ? Progress{} : it->second;
+                if (!p.finished)
+                {
+                    pending.emplace_back(task.event_name, in_time - boundary, p.executed, p.dispatches);
+                }
+            }
+        }
+        return {pending, running};
+    }
+
+    // whether the hyperperiod starting at `begin` is repeated by the next one: the same pending
+    // work at three consecutive boundaries, and the same segments in the two hyperperiods
+    bool recurs(const std::vector<Result> &results, int begin, int hyperperiod, int horizon, const PeriodicSchedule &schedule) const
+    {
+        auto first = state_at(results, begin);
+        if (first != state_at(results, begin + hyperperiod) || first != state_at(results, begin + 2 * hyperperiod))
+        {
+            return false;
+        }
+
+        std::vector<Result> window;
+        std::vector<Result> next;
+        for (const Result &result : results)
+        {
+            int b = result.response_begin_time;
+            if (b >= begin && b < begin + hyperperiod)
+            {
+                window.push_back(result);
+            }
+            else if (b >= begin + hyperperiod && b < begin + 2 * hyperperiod)
+            {
+                if (result.response_end_time > horizon)
+                {
+                    return false;
+                }
+                next.push_back(result);
+            }
+        }
+        if (window.size() != next.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < window.size(); ++i)
+        {
+            Result a = shift_result(window[i], 1, hyperperiod, schedule.periods);
+            const Result &b = next[i];
+            if (a.event_name != b.event_name || a.index != b.index || a.in_time != b.in_time || a.response_begin_time != b.response_begin_time || a.response_end_time != b.response_end_time || a.is_interrupted != b.is_interrupted || a.overhead != b.overhead)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::function<Strategy *()> make_strategy;
+    std::vector<Task> tasks;
+    std::shared_ptr<const JobSet> jobs;
+    tracing::TraceRecorder *trace;
+    int failed_at = -1;
+    bool stopped = true; // whether the last simulation stopped at its first miss
+};
+
+#endif // !HYPERPERIOD_HPP
@@ -3,12 +3,23 @@
 #include <fstream>
 #include <algorithm>
 #include <queue>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <functional>
+#include <memory>
+#include <cmath>
 
 #include "event.hpp"
 #include "result.hpp"
 #include "edf.hpp"
 #include "llf.hpp"
 #include "rms.hpp"
+#include "task.hpp"
+#include "hyperperiod.hpp"
+#include "server.hpp"
+#include "admission.hpp"
 
 enum class schedule_method
 {
@@ -17,78 +28,343 @@ enum class schedule_method
     LLF
 };
 
+const char *method_name(schedule_method method)
+{
+    return method == schedule_method::RMS ? "RMS" : method == schedule_method::EDF ? "EDF" : "LLF";
+}
+
+// stop, late, abort, skip or firm
+overload_policy parse_overload_policy(const std::string &name)
+{
+    if (name == "late") return overload_policy::RUN_LATE;
+    if (name == "abort") return overload_policy::ABORT;
+    if (name == "skip") return overload_policy::SKIP_NEXT;
+    if (name == "firm") return overload_policy::FIRM;
+    return overload_policy::STOP;
+}
+
+// every run gets a fresh strategy, which checkpoints itself if a checkpoint file is given
+Strategy *make_strategy(schedule_method method, const SwitchCost &cost, overload_policy policy, const std::string &checkpoint_file = "", int checkpoint_interval = 0)
+{
+    Strategy *strategy = nullptr;
+    switch (method)
+    {
+        case schedule_method::RMS:
+            strategy = new RMS();
+            break;
+        case schedule_method::EDF:
+            strategy = new EDF();
+            break;
+        case schedule_method::LLF:
+            strategy = new LLF();
+            break;
+    }
+    strategy->set_switch_cost(cost);
+    strategy->set_overload_policy(policy);
+    if (!checkpoint_file.empty())
+    {
+        strategy->set_checkpoint(checkpoint_file, checkpoint_interval);
+    }
+    return strategy;
+}
+
+// the share of the jobs that missed (finished late or were dropped), and how late the late ones were
+void print_overload(const PeriodicSchedule &schedule)
+{
+    long long jobs = 0, late = 0, dropped = 0;
+    for (auto &[name, stats] : schedule.statistics())
+    {
+        jobs += stats.jobs + stats.dropped;
+        late += stats.late;
+        dropped += stats.dropped;
+        std::cout << name << ": " << stats.jobs << " finished, " << stats.late << " late, " << stats.dropped << " dropped, mean lateness "
+                  << (double)stats.total_lateness / std::max(stats.late, 1LL) << ", max lateness " << stats.max_lateness << std::endl;
+    }
+    std::cout << "miss ratio " << (double)(late + dropped) / std::max(jobs, 1LL) << " (" << late << " late, " << dropped << " dropped of " << jobs << " jobs)" << std::endl;
+
+    std::map<int, long long> histogram = schedule.lateness_histogram();
+    if (late == 0)
+    {
+        return;
+    }
+    std::cout << "lateness percentiles:";
+    for (double percentile : {0.5, 0.9, 0.99, 1.0})
+    {
+        long long rank = (long long)std::ceil(percentile * late), seen = 0;
+        for (auto &[lateness, count] : histogram)
+        {
+            seen += count;
+            if (seen >= rank)
+            {
+                std::cout << " p" << percentile * 100 << " " << lateness;
+                break;
+            }
+        }
+    }
+    std::cout << std::endl;
+}
+
+// one column per method
+void print_comparison(const std::vector<schedule_method> &methods, const std::vector<PeriodicSchedule> &schedules, const std::vector<double> &seconds)
+{
+    auto row = [&methods](const std::string &name, const std::function<std::string(int)> &cell) {
+        std::cout << std::left << std::setw(24) << name;
+        for (int m = 0; m < (int)methods.size(); ++m)
+        {
+            std::cout << std::right << std::setw(16) << cell(m);
+        }
+        std::cout << std::endl;
+    };
+    auto number = [](double value) {
+        std::ostringstream out;
+        out << std::fixed << std::setprecision(2) << value;
+        return out.str();
+    };
+
+    // totals over all tasks, and the task names in order
+    std::vector<TaskStatistics> totals(methods.size());
+    std::vector<std::map<char, TaskStatistics>> stats(methods.size());
+    std::map<char, bool> names;
+    for (int m = 0; m < (int)methods.size(); ++m)
+    {
+        stats[m] = schedules[m].statistics();
+        for (auto &[name, s] : stats[m])
+        {
+            names[name] = true;
+            totals[m].jobs += s.jobs;
+            totals[m].preemptions += s.preemptions;
+            totals[m].total_response += s.total_response;
+            totals[m].max_response = std::max(totals[m].max_response, s.max_response);
+            totals[m].overhead += s.overhead;
+            totals[m].late += s.late;
+            totals[m].dropped += s.dropped;
+            totals[m].total_lateness += s.total_lateness;
+            totals[m].max_lateness = std::max(totals[m].max_lateness, s.max_lateness);
+        }
+    }
+
+    row("", [&](int m) { return std::string(method_name(methods[m])); });
+    row("feasible", [&](int m) { return schedules[m].succeed ? std::string("yes") : "miss at " + std::to_string(schedules[m].fail_time); });
+    row("finished jobs", [&](int m) { return std::to_string(totals[m].jobs); });
+    row("preemptions", [&](int m) { return std::to_string(totals[m].preemptions); });
+    row("mean response", [&](int m) { return number((double)totals[m].total_response / std::max(totals[m].jobs, 1LL)); });
+    row("max response", [&](int m) { return std::to_string(totals[m].max_response); });
+    row("switch overhead", [&](int m) { return std::to_string(totals[m].overhead); });
+    row("late / dropped", [&](int m) { return std::to_string(totals[m].late) + " / " + std::to_string(totals[m].dropped); });
+    row("miss ratio", [&](int m) { return number((double)(totals[m].late + totals[m].dropped) / std::max(totals[m].jobs + totals[m].dropped, 1LL)); });
+    row("mean lateness", [&](int m) { return number((double)totals[m].total_lateness / std::max(totals[m].late, 1LL)); });
+    row("max lateness", [&](int m) { return std::to_string(totals[m].max_lateness); });
+    for (auto &[name, unused] : names)
+    {
+        row(std::string("mean response of ") + name, [&, name = name](int m) {
+            auto it = stats[m].find(name);
+            return it == stats[m].end() ? std::string("-") : number((double)it->second.total_response / std::max(it->second.jobs, 1LL));
+        });
+    }
+    row("simulated ticks", [&](int m) { return std::to_string(schedules[m].simulated_time); });
+    row("wall time (ms)", [&](int m) { return number(seconds[m] * 1000); });
+}
+
+// the largest budget the admission test accepts for a server of this period next to the periodic tasks
+int server_budget(admission_policy policy, const std::vector<Task> &tasks, int period)
+{
+    AdmissionController controller(policy);
+    for (const Task &task : tasks)
+    {
+        if (task.is_cycle && controller.add_task({task.period_or_stop_time, task.run_time}) < 0)
+        {
+            return 0;
+        }
+    }
+    int low = 0, high = period;
+    while (low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if (controller.query({period, mid}))
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+// aperiodic response times under every server, RMS and EDF side by side
+void compare_servers(const std::vector<Task> &tasks, int total_time, int period, int budget)
+{
+    if (period <= 0)
+    {
+        // by default the server period is the shortest one, giving the server the top RMS priority
+        for (const Task &task : tasks)
+        {
+            if (task.is_cycle && (period <= 0 || task.period_or_stop_time < period))
+            {
+                period = task.period_or_stop_time;
+            }
+        }
+    }
+    if (period <= 0)
+    {
+        std::cout << "no periodic task to size a server by" << std::endl;
+        return;
+    }
+
+    JobSet jobs(tasks, total_time);
+    const server_type types[] = {server_type::BACKGROUND, server_type::POLLING, server_type::DEFERRABLE, server_type::TOTAL_BANDWIDTH};
+    const admission_policy policies[] = {admission_policy::RMS, admission_policy::EDF};
+    int budgets[2];
+    std::string cells[4][2];
+    for (int p = 0; p < 2; ++p)
+    {
+        budgets[p] = budget > 0 ? std::min(budget, period) : server_budget(policies[p], tasks, period);
+        double background_mean = 0;
+        for (int s = 0; s < 4; ++s)
+        {
+            bool edf = policies[p] == admission_policy::EDF;
+            if ((types[s] != server_type::BACKGROUND && budgets[p] <= 0) || (types[s] == server_type::TOTAL_BANDWIDTH && !edf))
+            {
+                cells[s][p] = "-";
+                continue;
+            }
+            ServerConfig config{types[s], period, budgets[p]};
+            Strategy *strategy = edf ? (Strategy *)new ServerScheduler<edf_cmp>(config) : new ServerScheduler<rms_cmp>(config);
+            result_pair result = strategy->run(jobs, total_time);
+            delete strategy;
+
+            long long jobs_done = 0, total_response = 0;
+            int max_response = 0;
+            for (const Result &r : result.first)
+            {
+                if (!r.is_interrupted && !tasks[r.event_name - 'A'].is_cycle)
+                {
+                    jobs_done++;
+                    total_response += r.response_end_time - r.in_time;
+                    max_response = std::max(max_response, r.response_end_time - r.in_time);
+                }
+            }
+            double mean = (double)total_response / std::max(jobs_done, 1LL);
+            if (s == 0)
+            {
+                background_mean = mean;
+            }
+            std::ostringstream out;
+            out << std::fixed << std::setprecision(1) << mean << " / " << max_response;
+            if (s > 0 && background_mean > 0)
+            {
+                out << " (" << std::setprecision(0) << (1 - mean / background_mean) * 100 << "%)";
+            }
+            if (!result.second)
+            {
+                out << " miss";
+            }
+            cells[s][p] = out.str();
+        }
+    }
+
+    std::cout << "server period " << period << ", budget " << budgets[0] << " under RMS and " << budgets[1] << " under EDF" << std::endl;
+    std::cout << "aperiodic response mean / max (gain over background), \"miss\" if a periodic deadline was missed" << std::endl;
+    std::cout << std::left << std::setw(20) << "" << std::right << std::setw(28) << "RMS" << std::setw(28) << "EDF" << std::endl;
+    for (int s = 0; s < 4; ++s)
+    {
+        std::cout << std::left << std::setw(20) << server_name(types[s]) << std::right << std::setw(28) << cells[s][0] << std::setw(28) << cells[s][1] << std::endl;
+    }
+}
+
 int main(int argc, char **argv)
 {
     schedule_method method = schedule_method::RMS;
     std::string test_file_name = "test.txt";
+    bool compare = false;
+    bool servers = false;
 
     if (argc > 1)
     {
+        compare = std::string(argv[1]) == "all" || std::string(argv[1]) == "0";
+        servers = std::string(argv[1]) == "servers" || std::string(argv[1]) == "4";
         method = std::atoi(argv[1]) == 1 ? schedule_method::RMS : std::atoi(argv[1]) == 2 ? schedule_method::EDF : schedule_method::LLF;
-        std::cout << "method: " << (method == schedule_method::RMS ? "RMS" : method == schedule_method::EDF ? "EDF" : "LLF") << std::endl;
+        std::cout << "method: " << (compare ? "all" : servers ? "servers" : method_name(method)) << std::endl;
     }
     else
     {
-        std::cout << "help: ./main [ RMS(1) | EDF(2) | LLF(3) ] " << std::endl;
+        std::cout << "help: ./main [ all(0) | RMS(1) | EDF(2) | LLF(3) ] [trace.json | -] [context_switch_cost] [cache_reload_cost] [ stop | late | abort | skip | firm ] [checkpoint_file] [checkpoint_interval]" << std::endl;
+        std::cout << "      ./main servers(4) [server_period] [server_budget]" << std::endl;
         return 0;
     }
 
+    // "-" for no trace
+    std::string trace_file_name = argc > 2 && std::string(argv[2]) != "-" ? argv[2] : "";
+    SwitchCost cost;
+    if (argc > 3)
+    {
+        cost.context_switch = std::atoi(argv[3]);
+    }
+    if (argc > 4)
+    {
+        cost.cache_reload = std::atoi(argv[4]);
+    }
+    // what to do after a missed deadline, stop by default
+    overload_policy policy = parse_overload_policy(argc > 5 ? argv[5] : "stop");
+    // a long single-method run saves its state every checkpoint_interval ticks and picks up
+    // from the checkpoint file when it is started again
+    std::string checkpoint_file = argc > 6 && std::string(argv[6]) != "-" ? argv[6] : "";
+    int checkpoint_interval = argc > 7 ? std::atoi(argv[7]) : 1000000;
+
     // open the file to read the data
     char event_name = 'A';
     int index, is_cycle, in_time, period_or_stop_time, run_time, total_time;
     std::ifstream infile(test_file_name);
     infile >> total_time;
-    std::priority_queue<Event, std::vector<Event>, std::less<Event>> event_queue;
+    std::vector<Task> tasks;
 
     while(infile >> index >> is_cycle >> in_time >> period_or_stop_time >> run_time)
     {
-        if (is_cycle)
+        tasks.push_back(Task{event_name : event_name, is_cycle : is_cycle != 0, in_time : in_time, period_or_stop_time : period_or_stop_time, run_time : run_time});
+        event_name++;
+    }
+
+    if (servers)
+    {
+        compare_servers(tasks, total_time, argc > 2 ? std::atoi(argv[2]) : 0, argc > 3 ? std::atoi(argv[3]) : 0);
+        return 0;
+    }
+
+    if (compare)
+    {
+        // one job set for every method, each method on its own thread
+        std::vector<schedule_method> methods = {schedule_method::RMS, schedule_method::EDF, schedule_method::LLF};
+        auto jobs = std::make_shared<const JobSet>(tasks, HyperperiodRunner::plan_horizon(tasks, total_time));
+        std::vector<PeriodicSchedule> schedules(methods.size());
+        std::vector<double> seconds(methods.size());
+        std::vector<std::thread> threads;
+        for (int m = 0; m < (int)methods.size(); ++m)
         {
-            // periodic task
-            int i = 0;
-            while(1)
-            {
-                // do something
-                int actual_in_time = in_time + i * period_or_stop_time;
-                if (actual_in_time > total_time)
-                {
-                    break;
-                }
-                Event event{index : i, in_time : actual_in_time, total_run_time : run_time, stop_time : actual_in_time + period_or_stop_time, event_name : event_name, time_pointer : 0, priority : 1000 / period_or_stop_time};
-                event_queue.push(event);
-                i++;
-            }
+            threads.emplace_back([&, m]() {
+                auto begin = std::chrono::steady_clock::now();
+                HyperperiodRunner runner([&methods, m, cost, policy]() { return make_strategy(methods[m], cost, policy); }, tasks, jobs);
+                schedules[m] = runner.run(total_time);
+                seconds[m] = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            });
         }
-        else
+        for (auto &thread : threads)
         {
-            // aperiodic task
-            Event event{index : 0, in_time : in_time, total_run_time : run_time, stop_time : period_or_stop_time, event_name : event_name, time_pointer : 0};
-            event_queue.push(event);
+            thread.join();
         }
-        event_name++;
+        print_comparison(methods, schedules, seconds);
+        return 0;
     }
 
-    // print the result
-    Strategy *strategy;
-    switch (method)
+    // an optional second argument is a Chrome trace file of the simulated part of the schedule
+    tracing::TraceRecorder trace(1000); // one time unit is shown as 1 ms
+    if (!checkpoint_file.empty() && std::ifstream(checkpoint_file))
     {
-        case schedule_method::RMS:
-            strategy = new RMS();
-            break;
-        case schedule_method::EDF:
-            strategy = new EDF();
-            break;
-        case schedule_method::LLF:
-            strategy = new LLF();
-            break;
-        default:
-            std::cout << "Invalid method." << std::endl;
-            return 0;
+        std::cout << "resuming from " << checkpoint_file << std::endl;
     }
-
-    result_pair result_pair = strategy->run(event_queue, total_time);
-    std::vector<Result> result = result_pair.first;
-    bool is_success = result_pair.second;
+    HyperperiodRunner runner([method, cost, policy, checkpoint_file, checkpoint_interval]() { return make_strategy(method, cost, policy, checkpoint_file, checkpoint_interval); }, tasks, nullptr, trace_file_name.empty() ? nullptr : &trace);
+    PeriodicSchedule schedule = runner.run(total_time);
+    bool is_success = schedule.succeed;
     if (!is_success)
     {
         // print with red color
@@ -99,16 +375,43 @@ int main(int argc, char **argv)
         std::cout << "\033[32mSuccess to schedule the events.\033[0m" << std::endl;
     }
 
+    if (!is_success && policy != overload_policy::STOP)
+    {
+        print_overload(schedule);
+    }
+
+    if (schedule.extrapolated)
+    {
+        std::cout << "Simulated " << schedule.simulated_time << " of " << total_time << " ticks, hyperperiod " << schedule.hyperperiod << " repeated " << schedule.window_repeat
+                  << " more times, " << schedule.segment_num() << " segments" << std::endl;
+        for (auto &[name, stats] : schedule.statistics())
+        {
+            std::cout << name << ": " << stats.jobs << " jobs, " << stats.preemptions << " preemptions, mean response " << (double)stats.total_response / std::max(stats.jobs, 1LL)
+                      << ", max response " << stats.max_response << ", switch overhead " << stats.overhead << std::endl;
+        }
+    }
+
+    // very long horizons are only written up to a limit
+    const long long max_output_segments = 2000000;
+    std::vector<Result> result = schedule.expand(max_output_segments);
+    if ((long long)result.size() < schedule.segment_num())
+    {
+        std::cout << "Writing the first " << result.size() << " segments only." << std::endl;
+    }
+
     // file to write the result
     std::ofstream outfile("result.txt");
     std::cout << "Result: " << std::endl;
     std::cout << "event_name in_time stop_time response_begin_time response_end_time" << std::endl;
-    for (int i = 0; i < result.size(); ++i)
+    for (size_t i = 0; i < result.size(); ++i)
     {
         // write to file and print to console at the same time
         outfile << result[i].event_name << result[i].index << " " << result[i].in_time << " " << result[i].stop_time << " " << result[i].response_begin_time << " " << result[i].response_end_time << std::endl;
         std::cout << result[i].event_name << result[i].index << " " << result[i].in_time << " " << result[i].stop_time << " " << result[i].response_begin_time << " " << result[i].response_end_time << std::endl;
     }
 
-    delete strategy;
+    if (!trace_file_name.empty())
+    {
+        trace.flush(trace_file_name);
+    }
 }
\ No newline at end of file
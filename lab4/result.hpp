@@ -10,6 +10,7 @@ struct Result
     int response_end_time;
     char event_name;
     bool is_interrupted;
+    int overhead = 0; // leading ticks spent on switching to the job rather than running it
 };
 
 #endif // !RESULT_HPP
\ No newline at end of file
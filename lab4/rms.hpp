@@ -8,13 +8,12 @@
 #include "result.hpp"
 #include "strategy.hpp"
 
-using event_queue_type = std::priority_queue<Event, std::vector<Event>, std::less<Event>>;
 using result_pair = std::pair<std::vector<Result>, bool>;
 
 // compare function for priority queue in RMS algorithm
 struct rms_cmp
 {
-    bool operator()(const Event &a, const Event &b)
+    constexpr bool operator()(const Event &a, const Event &b) const
     {
         if (a.priority == b.priority)
         {
@@ -29,29 +28,36 @@ class RMS: public Strategy
 public:
     RMS() {}
 
-    result_pair run(event_queue_type &events, int total_time) override
+    result_pair run(const JobSet &jobs, int total_time) override
     {
+        size_t job_num = jobs.count_until(total_time);
+        size_t next_job = 0;
         int i = 0;
+        restore(i, next_job, event_schedule_queue, job_num, total_time);
         while(1)
         {
-            if (events.empty() && event_schedule_queue.empty() && !is_running)
+            checkpoint(i, next_job, event_schedule_queue, job_num, total_time);
+            if (next_job == job_num && event_schedule_queue.empty() && !is_running)
             {
                 break;
             }
 
             // prepare the event schedule queue
-            Event event = events.top();
-            while (event.in_time == i - 1)
+            int arrived = 0;
+            while (next_job < job_num && jobs[next_job].in_time == i - 1)
             {
-                events.pop();
-                event_schedule_queue.push(event);
-                event_arrive = true;
-                if (events.empty())
-                {
-                    break;
-                }
-                event = events.top();
+                event_schedule_queue.push(jobs[next_job]);
+                next_job++;
+                arrived++;
+            }
+
+            // overload: a job that must not run any more is dropped before it gets the tick
+            if (is_running && should_drop(current_event, i))
+            {
+                drop_current(i);
             }
+            // only an arrival that is still queued can preempt
+            event_arrive = arrived > drop_waiting(event_schedule_queue, i);
 
             // execute the event
             if (!is_running)
@@ -60,6 +66,7 @@ public:
                 {
                     current_event = event_schedule_queue.top();
                     event_schedule_queue.pop();
+                    dispatch(current_event);
                     start_time = i; // begin to run
                     is_running = true;
                 }
@@ -76,42 +83,46 @@ public:
                     event_arrive = false;
                 }
 
-                if (i > current_event.stop_time) // fail to schedule
+                if (i > current_event.stop_time && miss(current_event, i)) // fail to schedule
                 {
-                    succeed = false;
                     break;
                 }
 
                 if (current_event.time_pointer == current_event.total_run_time) // finish running
                 {
                     Result result{index : current_event.index, in_time : current_event.in_time, stop_time : current_event.stop_time, response_begin_time : start_time - 1, response_end_time : i, event_name : current_event.event_name, is_interrupted : 0};
-                    results.push_back(result);
+                    record(result);
                     is_running = false;
                 }
             }
             i++;
         }
+        finish_checkpoints();
         return std::make_pair(results, succeed);
     }
 
 private:
     void preempt(int preempt_time) override
     {
+        if (event_schedule_queue.empty())
+        {
+            return;
+        }
         Event next_event = event_schedule_queue.top();
         if (next_event.priority > current_event.priority && !(current_event.time_pointer == current_event.total_run_time))
         {
             Result result{index : current_event.index, in_time : current_event.in_time, stop_time : current_event.stop_time, response_begin_time : start_time - 1, response_end_time : preempt_time - 1, event_name : current_event.event_name, is_interrupted : 1};
             current_event.time_pointer = current_event.time_pointer - 1;
             start_time = preempt_time; 
+            dispatch(next_event);
             next_event.time_pointer = next_event.time_pointer + 1;
             event_schedule_queue.pop();
+            record(result);
             event_schedule_queue.push(current_event);
-            results.push_back(result);
             current_event = next_event;
         }
     }
 
-    int start_time = 0;
     std::priority_queue<Event, std::vector<Event>, rms_cmp> event_schedule_queue;
 };
 
@@ -0,0 +1,209 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <deque>
+#include <queue>
+#include <vector>
+#include <algorithm>
+#include <climits>
+#include <stdexcept>
+#include "event.hpp"
+#include "result.hpp"
+#include "strategy.hpp"
+#include "edf.hpp"
+#include "rms.hpp"
+
+enum class server_type
+{
+    BACKGROUND, // aperiodic jobs only run when no periodic job is ready
+    POLLING, // budget at every period, lost when no aperiodic job is waiting
+    DEFERRABLE, // budget at every period, kept until it is used
+    TOTAL_BANDWIDTH // EDF only: every aperiodic job gets a deadline from the server bandwidth
+};
+
+inline const char *server_name(server_type type)
+{
+    switch (type)
+    {
+        case server_type::BACKGROUND:
+            return "background";
+        case server_type::POLLING:
+            return "polling";
+        case server_type::DEFERRABLE:
+            return "deferrable";
+        case server_type::TOTAL_BANDWIDTH:
+            return "total bandwidth";
+    }
+    return "";
+}
+
+// a server of `budget` ticks every `period` ticks, bandwidth budget / period
+struct ServerConfig
+{
+    server_type type = server_type::BACKGROUND;
+    int period = 1;
+    int budget = 0;
+};
+
+// RMS (rms_cmp) or EDF (edf_cmp) with the aperiodic jobs served by a server. The periodic
+// jobs keep hard deadlines, the aperiodic ones are served first come first served and only
+// their response times count. The polling and deferrable servers compete with the periodic
+// jobs as one more job, with priority 1000 / period under RMS and the end of the current
+// server period as deadline under EDF. The total-bandwidth server gives an aperiodic job of
+// run time C released at r the deadline max(r, previous deadline) + C * period / budget and
+// leaves it to EDF, so the stop_time of its segments is that deadline.
+template <typename Compare>
+class ServerScheduler: public Strategy
+{
+public:
+    explicit ServerScheduler(const ServerConfig &config) : config(config)
+    {
+        if (config.type != server_type::BACKGROUND && (config.period <= 0 || config.budget <= 0 || config.budget > config.period))
+        {
+            throw std::invalid_argument("a server needs 0 < budget <= period");
+        }
+    }
+
+    result_pair run(const JobSet &jobs, int total_time) override
+    {
+        size_t job_num = jobs.count_until(total_time);
+        size_t next_job = 0;
+        long long last_deadline = 0;
+        int t = 0; // the tick that runs [t, t + 1)
+        while (true)
+        {
+            if (next_job == job_num && event_schedule_queue.empty() && aperiodic_queue.empty() && !is_running)
+            {
+                break;
+            }
+
+            while (next_job < job_num && jobs[next_job].in_time == t)
+            {
+                Event job = jobs[next_job++];
+                if (job.is_cycle)
+                {
+                    event_schedule_queue.push(job);
+                }
+                else if (config.type == server_type::TOTAL_BANDWIDTH)
+                {
+                    long long span = ((long long)job.total_run_time * config.period + config.budget - 1) / config.budget;
+                    last_deadline = std::max<long long>(t, last_deadline) + span;
+                    job.stop_time = (int)std::min<long long>(last_deadline, INT_MAX);
+                    event_schedule_queue.push(job);
+                }
+                else
+                {
+                    aperiodic_queue.push_back(job);
+                }
+            }
+            replenish(t);
+
+            // the best periodic job, the server may still beat it
+            if (!event_schedule_queue.empty() && (!is_running || compare(current_event, event_schedule_queue.top())))
+            {
+                if (is_running)
+                {
+                    event_schedule_queue.push(current_event);
+                }
+                current_event = event_schedule_queue.top();
+                event_schedule_queue.pop();
+                is_running = true;
+            }
+            bool serve = !aperiodic_queue.empty() && (config.type == server_type::BACKGROUND ? !is_running : budget > 0 && (!is_running || compare(current_event, server_event)));
+
+            // a change of the running job closes the segment of the one that ran before
+            Event &job = serve ? aperiodic_queue.front() : current_event;
+            if (is_running || serve)
+            {
+                if (!has_segment || job.event_name != segment_job.event_name || job.index != segment_job.index)
+                {
+                    preempt(t);
+                    segment_job = job;
+                    segment_start = t;
+                    has_segment = true;
+                }
+            }
+            else
+            {
+                preempt(t);
+            }
+
+            if (serve)
+            {
+                job.time_pointer++;
+                budget -= config.type != server_type::BACKGROUND;
+                if (job.time_pointer == job.total_run_time)
+                {
+                    finish(job, t + 1);
+                    aperiodic_queue.pop_front();
+                    if (config.type == server_type::POLLING && aperiodic_queue.empty())
+                    {
+                        budget = 0; // nothing left to poll, the server suspends until its next period
+                    }
+                }
+            }
+            else if (is_running)
+            {
+                if (job.is_cycle && t >= job.stop_time) // fail to schedule
+                {
+                    succeed = false;
+                    fail_time = t + 1;
+                    break;
+                }
+                job.time_pointer++;
+                if (job.time_pointer == job.total_run_time)
+                {
+                    finish(job, t + 1);
+                    is_running = false;
+                }
+            }
+            t++;
+        }
+        return std::make_pair(results, succeed);
+    }
+
+private:
+    // close the open segment at preempt_time, as an interrupted one
+    void preempt(int preempt_time) override
+    {
+        if (has_segment)
+        {
+            Result result{index : segment_job.index, in_time : segment_job.in_time, stop_time : segment_job.stop_time, response_begin_time : segment_start, response_end_time : preempt_time, event_name : segment_job.event_name, is_interrupted : 1};
+            record(result);
+            has_segment = false;
+        }
+    }
+
+    void finish(const Event &job, int end_time)
+    {
+        Result result{index : job.index, in_time : job.in_time, stop_time : job.stop_time, response_begin_time : segment_start, response_end_time : end_time, event_name : job.event_name, is_interrupted : 0};
+        record(result);
+        has_segment = false;
+    }
+
+    // a new server period starts every config.period ticks
+    void replenish(int t)
+    {
+        if (config.type != server_type::POLLING && config.type != server_type::DEFERRABLE)
+        {
+            return;
+        }
+        if (t % config.period == 0)
+        {
+            budget = config.type == server_type::POLLING && aperiodic_queue.empty() ? 0 : config.budget;
+            server_event = Event{index : t / config.period, in_time : t, total_run_time : config.budget, stop_time : t + config.period, event_name : '$', time_pointer : 0, priority : 1000 / config.period, laxity : 0};
+        }
+    }
+
+    ServerConfig config;
+    int budget = 0;
+    Event server_event{};
+    Compare compare; // whether the first job ranks below the second
+    std::priority_queue<Event, std::vector<Event>, Compare> event_schedule_queue;
+    std::deque<Event> aperiodic_queue;
+    bool has_segment = false; // a segment of segment_job is open since segment_start
+    Event segment_job{};
+    int segment_start = 0;
+};
+
+#endif // !SERVER_HPP
@@ -2,28 +2,358 @@
 #define STRATEGY_HPP
 
 #include <queue>
+#include <string>
+#include <cstdio>
 #include <utility>
+#include <typeinfo>
+#include <algorithm>
+#include <filesystem>
 #include "event.hpp"
 #include "result.hpp"
+#include "../common/trace.hpp"
+#include "../common/snapshot.hpp"
+#include "task.hpp"
 
-using event_queue_type = std::priority_queue<Event, std::vector<Event>, std::less<Event>>;
 using result_pair = std::pair<std::vector<Result>, bool>;
 
+// What a switch costs, in ticks of work added to the job that gets the CPU: every dispatch
+// pays context_switch, and a job resumed after being preempted also pays cache_reload for
+// the cache lines the preempting jobs evicted (cache-related preemption delay).
+struct SwitchCost
+{
+    int context_switch = 0;
+    int cache_reload = 0;
+};
+
+// what happens to a job that misses its deadline
+enum class overload_policy
+{
+    STOP, // the run stops at the first miss
+    RUN_LATE, // the late job runs to completion
+    ABORT, // a job is dropped once its deadline has passed
+    SKIP_NEXT, // the late job runs to completion, and the next job of its task is dropped
+    FIRM // a job is dropped as soon as it cannot finish in time, so no job runs late
+};
+
+// a job that was dropped under an overload policy
+struct DroppedJob
+{
+    char event_name;
+    int index;
+    int in_time;
+    int stop_time;
+    int drop_time;
+};
+
 // a base class for all strategies
 class Strategy
 {
 public:
-    Strategy() {}
+    Strategy()
+    {
+        std::fill(std::begin(skip_index), std::end(skip_index), -1);
+    }
     virtual ~Strategy() {}
-    virtual result_pair run(event_queue_type &events, int total_time) = 0;
+    // the jobs are only read, so several strategies may run on one set at the same time
+    virtual result_pair run(const JobSet &jobs, int total_time) = 0;
     virtual void preempt(int preempt_time) = 0;
 
+    // also record every run segment on a CPU lane of this trace
+    void set_trace(tracing::TraceRecorder *new_trace)
+    {
+        trace = new_trace;
+        if (trace)
+        {
+            trace->set_lane_name(0, 0, "CPU 0");
+        }
+    }
+
+    void set_switch_cost(const SwitchCost &new_cost)
+    {
+        cost = new_cost;
+    }
+
+    void set_overload_policy(overload_policy new_policy)
+    {
+        policy = new_policy;
+    }
+
+    // whether run() returns at the first miss instead of going on to the end
+    bool stops_on_miss() const
+    {
+        return policy == overload_policy::STOP;
+    }
+
+    const std::vector<DroppedJob> &get_dropped() const
+    {
+        return dropped;
+    }
+
+    // the tick at which a deadline was missed, -1 if none was
+    int get_fail_time() const
+    {
+        return fail_time;
+    }
+
+    // Save the state of run() to `file` every `interval` ticks, the results and dropped jobs
+    // produced since the last checkpoint being appended to file + ".results" / ".dropped", so a
+    // checkpoint costs the queue and what is new rather than the whole history. A run that finds
+    // a checkpoint of the same strategy and job set in `file` goes on from it; a finished run
+    // removes the files. The trace only covers what was simulated after the resume.
+    void set_checkpoint(const std::string &file, int interval)
+    {
+        checkpoint_file = file;
+        checkpoint_interval = interval;
+    }
+
+    // whether the last run() started from a checkpoint, and at which tick
+    int get_resume_time() const
+    {
+        return resume_time;
+    }
+
 protected:
+    // a job gets the CPU: charge it the switch before it goes on with its own work
+    void dispatch(Event &event)
+    {
+        int charge = cost.context_switch + (event.time_pointer > 0 ? cost.cache_reload : 0);
+        event.total_run_time += charge;
+        event.overhead += charge;
+    }
+
+    // the running job is late at tick time; true if the run stops here
+    bool miss(const Event &job, int time)
+    {
+        if (succeed)
+        {
+            succeed = false;
+            fail_time = time;
+        }
+        if (policy == overload_policy::SKIP_NEXT)
+        {
+            skip_index[(unsigned char)job.event_name] = job.index + 1;
+        }
+        return policy == overload_policy::STOP;
+    }
+
+    // whether a job must be dropped rather than run at tick time, which runs [time - 1, time)
+    bool should_drop(const Event &job, int time) const
+    {
+        switch (policy)
+        {
+            case overload_policy::ABORT:
+                return time > job.stop_time;
+            case overload_policy::FIRM:
+                return time - 1 + (job.total_run_time - job.time_pointer) > job.stop_time;
+            case overload_policy::SKIP_NEXT:
+                return skip_index[(unsigned char)job.event_name] == job.index;
+            default:
+                return false;
+        }
+    }
+
+    void drop(const Event &job, int time)
+    {
+        if (succeed && policy != overload_policy::SKIP_NEXT)
+        {
+            succeed = false;
+            fail_time = time;
+        }
+        dropped.push_back(DroppedJob{job.event_name, job.index, job.in_time, job.stop_time, time - 1});
+        if (trace)
+        {
+            trace->instant(0, 0, time - 1, "dropped", -1, task_name(job.event_name), job.index);
+        }
+    }
+
+    // drop the jobs at the head of the queue that must not run at tick time, and return how
+    // many of them arrived at this tick
+    template <typename Queue>
+    int drop_waiting(Queue &queue, int time)
+    {
+        int dropped_arrivals = 0;
+        while (!queue.empty() && should_drop(queue.top(), time))
+        {
+            dropped_arrivals += queue.top().in_time == time - 1;
+            drop(queue.top(), time);
+            queue.pop();
+        }
+        return dropped_arrivals;
+    }
+
+    // drop the running job, keeping the part it ran as an interrupted segment
+    void drop_current(int time)
+    {
+        if (start_time < time)
+        {
+            record(Result{index : current_event.index, in_time : current_event.in_time, stop_time : current_event.stop_time, response_begin_time : start_time - 1, response_end_time : time - 1, event_name : current_event.event_name, is_interrupted : 1});
+        }
+        drop(current_event, time);
+        is_running = false;
+    }
+
+    // keep a finished or preempted segment of the current event, which does the switching
+    // work it owes first
+    void record(Result result)
+    {
+        result.overhead = std::min(current_event.overhead, result.response_end_time - result.response_begin_time);
+        current_event.overhead -= result.overhead;
+        results.push_back(result);
+        if (trace)
+        {
+            trace->complete(0, 0, result.response_begin_time, result.response_end_time, task_name(result.event_name), result.index, "deadline", result.stop_time);
+            if (result.overhead > 0)
+            {
+                trace->complete(0, 0, result.response_begin_time, result.response_begin_time + result.overhead, "switch");
+            }
+        }
+    }
+
+    // at the start of run(): load the state of a matching checkpoint, if there is one
+    template <typename Queue>
+    void restore(int &time, size_t &next_job, Queue &queue, size_t job_num, int total_time)
+    {
+        if (checkpoint_file.empty())
+        {
+            return;
+        }
+        next_checkpoint = checkpoint_interval > 0 ? checkpoint_interval : -1;
+        if (!std::filesystem::exists(checkpoint_file))
+        {
+            return;
+        }
+        snapshot::Reader in(checkpoint_file, "SCHD");
+        RunState state = in.get<RunState>();
+        if (checkpoint_kind() != in.get<uint64_t>() || state.job_num != job_num || state.total_time != total_time)
+        {
+            return; // a checkpoint of another run, it is overwritten
+        }
+        time = state.time;
+        next_job = state.next_job;
+        is_running = state.is_running;
+        start_time = state.start_time;
+        succeed = state.succeed;
+        fail_time = state.fail_time;
+        event_arrive = state.event_arrive;
+        current_event = state.current_event;
+        std::copy(std::begin(state.skip_index), std::end(state.skip_index), std::begin(skip_index));
+        heap_of(queue) = in.get_vector<Event>(); // saved in heap order
+        results = snapshot::read_log<Result>(checkpoint_file + ".results", state.result_num);
+        dropped = snapshot::read_log<DroppedJob>(checkpoint_file + ".dropped", state.dropped_num);
+        logged_result_num = results.size();
+        logged_dropped_num = dropped.size();
+        resume_time = time;
+        if (checkpoint_interval > 0)
+        {
+            next_checkpoint = time + checkpoint_interval;
+        }
+    }
+
+    // at the top of every tick of run(), before anything happens in it
+    template <typename Queue>
+    void checkpoint(int time, size_t next_job, Queue &queue, size_t job_num, int total_time)
+    {
+        if (time != next_checkpoint)
+        {
+            return;
+        }
+        next_checkpoint += checkpoint_interval;
+
+        // the logs first: a checkpoint never refers to results that are not on disk
+        snapshot::append_log(checkpoint_file + ".results", results.data() + logged_result_num, results.size() - logged_result_num, logged_result_num == 0);
+        snapshot::append_log(checkpoint_file + ".dropped", dropped.data() + logged_dropped_num, dropped.size() - logged_dropped_num, logged_dropped_num == 0);
+        logged_result_num = results.size();
+        logged_dropped_num = dropped.size();
+
+        RunState state{time, next_job, job_num, total_time, is_running, start_time, succeed, fail_time, event_arrive, current_event, results.size(), dropped.size(), {}};
+        std::copy(std::begin(skip_index), std::end(skip_index), std::begin(state.skip_index));
+        snapshot::Writer out(checkpoint_file, "SCHD");
+        out.put(state);
+        out.put(checkpoint_kind());
+        out.put_vector(heap_of(queue));
+        out.commit();
+    }
+
+    // at the end of run(): the checkpoint of a finished run is of no use
+    void finish_checkpoints()
+    {
+        if (!checkpoint_file.empty())
+        {
+            std::remove(checkpoint_file.c_str());
+            std::remove((checkpoint_file + ".results").c_str());
+            std::remove((checkpoint_file + ".dropped").c_str());
+        }
+    }
+
+    const char *task_name(char event_name)
+    {
+        const char *&name = task_names[(unsigned char)event_name];
+        if (name == nullptr)
+        {
+            name = trace->intern(std::string(1, event_name));
+        }
+        return name;
+    }
+
+    SwitchCost cost;
+    overload_policy policy = overload_policy::STOP;
+    std::vector<DroppedJob> dropped;
+    int skip_index[256]; // per task, the index of the job to skip, -1 for none
     bool is_running = false;
+    int start_time = 0;
     bool succeed = true;
+    int fail_time = -1;
     bool event_arrive = false;
     Event current_event;
     std::vector<Result> results;
+    tracing::TraceRecorder *trace = nullptr;
+    const char *task_names[256] = {};
+
+private:
+    // the scalars of a checkpoint, followed by the queue, the dropped jobs and the results log
+    struct RunState
+    {
+        int time;
+        size_t next_job;
+        size_t job_num;
+        int total_time;
+        bool is_running;
+        int start_time;
+        bool succeed;
+        int fail_time;
+        bool event_arrive;
+        Event current_event;
+        size_t result_num;
+        size_t dropped_num;
+        int skip_index[256];
+    };
+
+    // the array under a std::priority_queue, a protected member
+    template <typename Queue>
+    static typename Queue::container_type &heap_of(Queue &queue)
+    {
+        struct Access : Queue
+        {
+            static typename Queue::container_type &get(Queue &queue)
+            {
+                return queue.*&Access::c;
+            }
+        };
+        return Access::get(queue);
+    }
+
+    // which strategy wrote a checkpoint
+    uint64_t checkpoint_kind() const
+    {
+        return typeid(*this).hash_code();
+    }
+
+    std::string checkpoint_file;
+    int checkpoint_interval = 0;
+    int next_checkpoint = -1;
+    size_t logged_result_num = 0;
+    size_t logged_dropped_num = 0;
+    int resume_time = -1;
 };
 
 #endif // !STRATEGY_HPP
\ No newline at end of file
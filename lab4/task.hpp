@@ -0,0 +1,76 @@
+#ifndef TASK_HPP
+#define TASK_HPP
+
+#include <vector>
+#include <algorithm>
+#include "event.hpp"
+
+// one line of test.txt
+struct Task
+{
+    char event_name;
+    bool is_cycle;
+    int in_time;
+    int period_or_stop_time; // the period of a periodic task, the deadline of an aperiodic one
+    int run_time;
+};
+
+// Every job the tasks release up to a horizon, sorted by release time (ties in task order).
+// It is never changed after construction, so one set can be shared by strategies running
+// on different threads, and a run to a shorter horizon just reads a prefix of it.
+class JobSet
+{
+public:
+    JobSet(const std::vector<Task> &tasks, int horizon) : horizon(horizon)
+    {
+        for (const Task &task : tasks)
+        {
+            if (task.is_cycle)
+            {
+                // periodic task
+                for (int i = 0; task.in_time + (long long)i * task.period_or_stop_time <= horizon; ++i)
+                {
+                    int actual_in_time = task.in_time + i * task.period_or_stop_time;
+                    jobs.push_back(Event{index : i, in_time : actual_in_time, total_run_time : task.run_time, stop_time : actual_in_time + task.period_or_stop_time, event_name : task.event_name, time_pointer : 0, priority : 1000 / task.period_or_stop_time, laxity : 0});
+                }
+            }
+            else
+            {
+                // aperiodic task, kept even when it comes after the horizon
+                jobs.push_back(Event{index : 0, in_time : task.in_time, total_run_time : task.run_time, stop_time : task.period_or_stop_time, event_name : task.event_name, time_pointer : 0, priority : 0, laxity : 0, is_cycle : false});
+            }
+        }
+        std::stable_sort(jobs.begin(), jobs.end(), [](const Event &a, const Event &b) { return a.in_time < b.in_time; });
+    }
+
+    size_t size() const
+    {
+        return jobs.size();
+    }
+
+    const Event &operator[](size_t i) const
+    {
+        return jobs[i];
+    }
+
+    // the number of jobs released at or before time, all of them from the horizon on
+    size_t count_until(int time) const
+    {
+        if (time >= horizon)
+        {
+            return jobs.size();
+        }
+        return std::upper_bound(jobs.begin(), jobs.end(), time, [](int t, const Event &job) { return t < job.in_time; }) - jobs.begin();
+    }
+
+    int get_horizon() const
+    {
+        return horizon;
+    }
+
+private:
+    std::vector<Event> jobs;
+    int horizon;
+};
+
+#endif // !TASK_HPP
@@ -0,0 +1,487 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mypipe_ring.h"
+#include "mypipe_broadcast.h"
+
+// fan messages out from writer processes to reader processes, every reader receiving every
+// message: over the broadcast ring (one copy in, one cursor per reader), or over one framed
+// mypipe ring per reader (each message written once per reader). Reports the throughput of
+// every reader, the delivered total, latency percentiles and how evenly the writers shared
+// the ring
+//
+// usage: ./broadcast_bench [-t broadcast|mypipe] [-p writers] [-r readers] [-s message_size]
+//                          [-n messages_per_writer] [-b ring_size] [-v batch] [-c]
+
+#define DEFAULT_RING_SIZE 65536
+#define MAX_BATCH 1024
+
+enum transport_type
+{
+    TRANSPORT_BROADCAST,
+    TRANSPORT_MYPIPE
+};
+
+static const char *transport_names[] = {"broadcast", "mypipe"};
+
+// every message begins with this header, the rest is filled with a pattern derived from seq
+struct message_header
+{
+    uint64_t seq; // per writer
+    uint64_t send_ns;
+    uint32_t writer;
+};
+
+struct reader_result
+{
+    long received;
+    long seq_errors;
+    long payload_errors;
+    uint64_t first_ns;
+    uint64_t last_ns;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+};
+
+struct writer_result
+{
+    uint64_t begin_ns;
+    uint64_t end_ns;
+};
+
+// everything the processes share
+struct shared_state
+{
+    _Atomic int ready; // processes waiting for the start
+    struct reader_result readers[MYPIPE_BROADCAST_MAX_READERS];
+    struct writer_result writers[MYPIPE_BROADCAST_MAX_READERS];
+};
+
+struct options
+{
+    enum transport_type type;
+    int writer_num;
+    int reader_num;
+    size_t message_size;
+    long message_number; // per writer
+    size_t ring_size;
+    int batch;
+    int check_payload;
+};
+
+struct transport
+{
+    struct shared_state *state;
+    struct mypipe_broadcast *broadcast;
+    char *rings; // reader_num mypipe rings, ring_bytes apart
+    size_t ring_bytes;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static char pattern_byte(uint64_t seq, size_t offset)
+{
+    return (char)((seq + offset) * 31 + 97);
+}
+
+static struct mypipe_ring *ring_of(struct transport *t, int reader)
+{
+    return (struct mypipe_ring *)(t->rings + reader * t->ring_bytes);
+}
+
+static void *map_shared(size_t bytes)
+{
+    void *memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        perror("[ERROR] Fail to map shared memory");
+        exit(1);
+    }
+    return memory;
+}
+
+static void transport_open(struct transport *t, const struct options *opt)
+{
+    t->state = map_shared(sizeof(struct shared_state));
+    atomic_init(&t->state->ready, 0);
+    t->broadcast = NULL;
+    t->rings = NULL;
+    if (opt->type == TRANSPORT_BROADCAST)
+    {
+        t->broadcast = map_shared(mypipe_broadcast_bytes(opt->ring_size));
+        mypipe_broadcast_init(t->broadcast, opt->ring_size, opt->reader_num);
+        return;
+    }
+    t->ring_bytes = (mypipe_ring_bytes(opt->ring_size) + 63) / 64 * 64;
+    t->rings = map_shared(t->ring_bytes * opt->reader_num);
+    for (int i = 0; i < opt->reader_num; i++)
+    {
+        mypipe_ring_init(ring_of(t, i), opt->ring_size, 1);
+    }
+}
+
+// every process waits here until all of them have started
+static void wait_for_start(struct transport *t, const struct options *opt)
+{
+    atomic_fetch_add(&t->state->ready, 1);
+    while (atomic_load(&t->state->ready) < opt->writer_num + opt->reader_num)
+    {
+        sched_yield();
+    }
+}
+
+// sends `number` messages, as one batch when batching
+static int send_messages(struct transport *t, const struct options *opt, char *messages, int number)
+{
+    struct iovec iov[MAX_BATCH];
+    for (int k = 0; k < number; k++)
+    {
+        iov[k].iov_base = messages + k * opt->message_size;
+        iov[k].iov_len = opt->message_size;
+    }
+    if (opt->type == TRANSPORT_BROADCAST)
+    {
+        for (int sent = 0; sent < number;)
+        {
+            ssize_t n = opt->batch > 1 ? mypipe_broadcast_writev_wait(t->broadcast, iov + sent, number - sent)
+                                       : (mypipe_broadcast_write_wait(t->broadcast, messages, opt->message_size) < 0 ? -1 : 1);
+            if (n < 0)
+            {
+                return -1;
+            }
+            sent += n;
+        }
+        return 0;
+    }
+
+    // a copy of every message for every reader
+    for (int i = 0; i < opt->reader_num; i++)
+    {
+        struct iovec *next = iov;
+        int iovcnt = number;
+        while (iovcnt > 0)
+        {
+            ssize_t n = opt->batch > 1 ? mypipe_ring_writev_wait(ring_of(t, i), next, iovcnt, 1)
+                                       : mypipe_ring_write_frame_wait(ring_of(t, i), messages, opt->message_size);
+            if (n < 0)
+            {
+                return -1;
+            }
+            next += n / opt->message_size;
+            iovcnt -= n / opt->message_size;
+        }
+    }
+    return 0;
+}
+
+static void run_writer(struct transport *t, const struct options *opt, int writer)
+{
+    char *messages = malloc(opt->message_size * opt->batch);
+    struct message_header header;
+    memset(&header, 0, sizeof(header));
+    for (int k = 0; k < opt->batch; k++)
+    {
+        for (size_t j = sizeof(header); j < opt->message_size; j++)
+        {
+            messages[k * opt->message_size + j] = pattern_byte(0, j);
+        }
+    }
+
+    wait_for_start(t, opt);
+    t->state->writers[writer].begin_ns = now_ns();
+    for (long i = 0; i < opt->message_number; i += opt->batch)
+    {
+        int number = min(opt->batch, opt->message_number - i);
+        for (int k = 0; k < number; k++)
+        {
+            char *message = messages + k * opt->message_size;
+            if (opt->check_payload)
+            {
+                for (size_t j = sizeof(header); j < opt->message_size; j++)
+                {
+                    message[j] = pattern_byte(i + k, j);
+                }
+            }
+            header.seq = i + k;
+            header.send_ns = now_ns();
+            header.writer = writer;
+            memcpy(message, &header, sizeof(header));
+        }
+        if (send_messages(t, opt, messages, number) != 0)
+        {
+            fprintf(stderr, "[ERROR] Writer %d fails to send.\n", writer);
+            break;
+        }
+    }
+    t->state->writers[writer].end_ns = now_ns();
+    free(messages);
+}
+
+static int compare_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+// receives one message into `message`, the framed mypipe ring reading a batch into `wire`
+// when batching and handing out its records one by one
+static int recv_message(struct transport *t, const struct options *opt, int reader, char *message, char *wire, size_t *wire_used, size_t *wire_next)
+{
+    if (opt->type == TRANSPORT_BROADCAST)
+    {
+        return mypipe_broadcast_read_wait(t->broadcast, reader, message, opt->message_size) == (ssize_t)opt->message_size ? 0 : -1;
+    }
+    if (opt->batch == 1)
+    {
+        return mypipe_ring_read_frame_wait(ring_of(t, reader), message, opt->message_size) == (ssize_t)opt->message_size ? 0 : -1;
+    }
+
+    size_t record = sizeof(mypipe_frame_header) + opt->message_size;
+    if (*wire_next == *wire_used)
+    {
+        struct iovec iov = {wire, record * opt->batch};
+        ssize_t n = mypipe_ring_readv_wait(ring_of(t, reader), &iov, 1, 1);
+        if (n <= 0 || n % record != 0)
+        {
+            return -1;
+        }
+        *wire_used = n;
+        *wire_next = 0;
+    }
+    mypipe_frame_header length;
+    memcpy(&length, wire + *wire_next, sizeof(length));
+    memcpy(message, wire + *wire_next + sizeof(length), opt->message_size);
+    *wire_next += record;
+    return length == opt->message_size ? 0 : -1;
+}
+
+static void run_reader(struct transport *t, const struct options *opt, int reader)
+{
+    long total = opt->message_number * opt->writer_num;
+    char *message = malloc(opt->message_size);
+    char *wire = malloc((sizeof(mypipe_frame_header) + opt->message_size) * opt->batch);
+    size_t wire_used = 0;
+    size_t wire_next = 0;
+    uint64_t *latency = malloc(total * sizeof(uint64_t));
+    uint64_t *expected = calloc(opt->writer_num, sizeof(uint64_t)); // the next seq of each writer
+    struct reader_result result;
+    memset(&result, 0, sizeof(result));
+    struct message_header header;
+
+    wait_for_start(t, opt);
+    result.first_ns = now_ns();
+    for (long i = 0; i < total; i++)
+    {
+        if (recv_message(t, opt, reader, message, wire, &wire_used, &wire_next) != 0)
+        {
+            fprintf(stderr, "[ERROR] Reader %d fails after %ld messages.\n", reader, i);
+            break;
+        }
+        result.last_ns = now_ns();
+        memcpy(&header, message, sizeof(header));
+        latency[i] = result.last_ns - header.send_ns;
+        result.received++;
+
+        // the messages of a writer must come in order, whatever the interleaving
+        if (header.writer >= (uint32_t)opt->writer_num || header.seq != expected[header.writer])
+        {
+            result.seq_errors++;
+        }
+        if (header.writer < (uint32_t)opt->writer_num)
+        {
+            expected[header.writer] = header.seq + 1;
+        }
+        if (opt->check_payload)
+        {
+            for (size_t j = sizeof(header); j < opt->message_size; j++)
+            {
+                if (message[j] != pattern_byte(header.seq, j))
+                {
+                    result.payload_errors++;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (result.received > 0)
+    {
+        qsort(latency, result.received, sizeof(uint64_t), compare_uint64);
+        result.p50 = latency[(long)(0.5 * (result.received - 1))];
+        result.p99 = latency[(long)(0.99 * (result.received - 1))];
+        result.max = latency[result.received - 1];
+    }
+    t->state->readers[reader] = result;
+    free(message);
+    free(wire);
+    free(latency);
+    free(expected);
+}
+
+static int print_results(const struct transport *t, const struct options *opt)
+{
+    long total = opt->message_number * opt->writer_num;
+    double megabytes_per_reader = (double)total * opt->message_size / (1024.0 * 1024.0);
+    uint64_t begin = UINT64_MAX;
+    uint64_t end = 0;
+    long delivered = 0;
+    int ok = 1;
+
+    printf("transport %s writers %d readers %d message_size %zu messages %ld batch %d\n", transport_names[opt->type], opt->writer_num, opt->reader_num,
+           opt->message_size, total, opt->batch);
+    for (int i = 0; i < opt->reader_num; i++)
+    {
+        const struct reader_result *r = &t->state->readers[i];
+        double seconds = (r->last_ns - r->first_ns) / 1e9;
+        printf("reader %d: %ld messages %.2f MB/s latency(ns) p50 %lu p99 %lu max %lu seq_errors %ld payload_errors %ld\n", i, r->received,
+               seconds > 0 ? megabytes_per_reader * r->received / total / seconds : 0.0, r->p50, r->p99, r->max, r->seq_errors, r->payload_errors);
+        begin = min(begin, r->first_ns);
+        end = r->last_ns > end ? r->last_ns : end;
+        delivered += r->received;
+        ok = ok && r->received == total && r->seq_errors == 0 && r->payload_errors == 0;
+    }
+    double seconds = (end - begin) / 1e9;
+    printf("fan-out %.2f MB/s delivered %.0f msg/s\n", (double)delivered * opt->message_size / (1024.0 * 1024.0) / seconds, delivered / seconds);
+
+    // Jain's index of the writer rates: 1 when they all got the same share of the ring
+    double sum = 0;
+    double square_sum = 0;
+    for (int w = 0; w < opt->writer_num; w++)
+    {
+        const struct writer_result *r = &t->state->writers[w];
+        double rate = opt->message_number / ((r->end_ns - r->begin_ns) / 1e9);
+        printf("writer %d: %.0f msg/s\n", w, rate);
+        sum += rate;
+        square_sum += rate * rate;
+    }
+    printf("writer fairness %.3f\n", sum * sum / (opt->writer_num * square_sum));
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct options opt = {
+        .type = TRANSPORT_BROADCAST,
+        .writer_num = 1,
+        .reader_num = 4,
+        .message_size = 64,
+        .message_number = 100000,
+        .ring_size = DEFAULT_RING_SIZE,
+        .batch = 1,
+        .check_payload = 0,
+    };
+
+    int c;
+    while ((c = getopt(argc, argv, "t:p:r:s:n:b:v:c")) != -1)
+    {
+        switch (c)
+        {
+        case 't':
+            if (strcmp(optarg, "broadcast") == 0)
+            {
+                opt.type = TRANSPORT_BROADCAST;
+            }
+            else if (strcmp(optarg, "mypipe") == 0)
+            {
+                opt.type = TRANSPORT_MYPIPE;
+            }
+            else
+            {
+                fprintf(stderr, "[ERROR] Unknown transport %s.\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'p':
+            opt.writer_num = atoi(optarg);
+            break;
+        case 'r':
+            opt.reader_num = atoi(optarg);
+            break;
+        case 's':
+            opt.message_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            opt.message_number = strtol(optarg, NULL, 10);
+            break;
+        case 'b':
+            opt.ring_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'v':
+            opt.batch = atoi(optarg);
+            break;
+        case 'c':
+            opt.check_payload = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t broadcast|mypipe] [-p writers] [-r readers] [-s size] [-n number] [-b ring_size] [-v batch] [-c]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (opt.message_size < sizeof(struct message_header) || opt.message_number <= 0)
+    {
+        fprintf(stderr, "[ERROR] Message size must be at least %zu bytes.\n", sizeof(struct message_header));
+        exit(1);
+    }
+    if (opt.writer_num < 1 || opt.writer_num > MYPIPE_BROADCAST_MAX_READERS || opt.reader_num < 1 || opt.reader_num > MYPIPE_BROADCAST_MAX_READERS)
+    {
+        fprintf(stderr, "[ERROR] Writers and readers must be between 1 and %d.\n", MYPIPE_BROADCAST_MAX_READERS);
+        exit(1);
+    }
+    if (opt.batch < 1 || opt.batch > MAX_BATCH)
+    {
+        fprintf(stderr, "[ERROR] A batch holds 1 to %d messages.\n", MAX_BATCH);
+        exit(1);
+    }
+    if (opt.ring_size % MYPIPE_BROADCAST_ALIGN != 0 || mypipe_broadcast_record(opt.message_size) > opt.ring_size)
+    {
+        fprintf(stderr, "[ERROR] The ring size must be a multiple of %d that holds a message.\n", MYPIPE_BROADCAST_ALIGN);
+        exit(1);
+    }
+
+    struct transport t;
+    transport_open(&t, &opt);
+
+    for (int i = 0; i < opt.reader_num + opt.writer_num; i++)
+    {
+        pid_t pid = fork();
+        if (pid < 0)
+        {
+            perror("[ERROR] Fail to fork");
+            exit(1);
+        }
+        if (pid == 0)
+        {
+            if (i < opt.reader_num)
+            {
+                run_reader(&t, &opt, i);
+            }
+            else
+            {
+                run_writer(&t, &opt, i - opt.reader_num);
+            }
+            _exit(0);
+        }
+    }
+    while (wait(NULL) > 0)
+    {
+    }
+    return print_results(&t, &opt);
+}
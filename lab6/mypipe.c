@@ -4,8 +4,13 @@
 #include <linux/semaphore.h>
 #include <linux/fs.h>
 #include <linux/slab.h>
+#include <linux/mm.h>
+#include <linux/uio.h>
+#include <linux/moduleparam.h>
+#include <linux/version.h>
 
-#define PIPE_BUFFER_SIZE 16
+#define PIPE_BUFFER_SIZE 16 // the stream mode, small to show the wrap-around
+#define FRAMED_BUFFER_SIZE 65536 // the framed mode, room for records of up to 64 KiB - 4
 #define IGNORE_BUFFER_SIZE 16
 #define PIPE_NUMBER 200
 
@@ -19,10 +24,270 @@ static int flag = 0; // whether the buffer is empty or full
 static ssize_t p_read; // the pointer to read
 static ssize_t p_write; // the pointer to write
 static char* kernel_buffer; // the buffer in kernel space
+static ssize_t pipe_buffer_size; // the size of kernel_buffer
 
 static struct mutex mutex_buffer;
 static struct semaphore sem;
 
+// framed mode: every write is one record, stored as its length followed by the bytes, and
+// is taken whole or not at all; every read returns one whole record
+static bool framed = false;
+module_param(framed, bool, 0444);
+MODULE_PARM_DESC(framed, "keep message boundaries (length-prefixed records)");
+
+static uint buffer_size = 0;
+module_param(buffer_size, uint, 0444);
+MODULE_PARM_DESC(buffer_size, "the size of the buffer in bytes, 0 for 16 (65536 when framed)");
+
+typedef u32 frame_header; // the length of the record that follows
+
+// the number of bytes in the buffer
+static size_t mypipe_used(void)
+{
+    if (p_read == p_write)
+    {
+        return flag ? pipe_buffer_size : 0;
+    }
+    return (p_write - p_read + pipe_buffer_size) % pipe_buffer_size;
+}
+
+// the length of the record at p_read, the caller checked that the buffer is not empty
+static frame_header mypipe_peek_header(void)
+{
+    frame_header length;
+    size_t max_no_iterable = min(sizeof(length), (size_t)(pipe_buffer_size - p_read));
+    memcpy(&length, kernel_buffer + p_read, max_no_iterable);
+    memcpy((char *)&length + max_no_iterable, kernel_buffer, sizeof(length) - max_no_iterable);
+    return length;
+}
+
+// the helpers below move n bytes in or out at the pointers, the caller checked that they fit
+static void mypipe_store_header(ssize_t position, frame_header length)
+{
+    size_t max_no_iterable = min(sizeof(length), (size_t)(pipe_buffer_size - position));
+    memcpy(kernel_buffer + position, &length, max_no_iterable);
+    memcpy(kernel_buffer, (char *)&length + max_no_iterable, sizeof(length) - max_no_iterable);
+}
+
+static int mypipe_put_user(const char __user *buf, size_t n)
+{
+    size_t max_no_iterable = min(n, (size_t)(pipe_buffer_size - p_write));
+    int ret = copy_from_user(kernel_buffer + p_write, buf, max_no_iterable);
+    ret |= copy_from_user(kernel_buffer, buf + max_no_iterable, n - max_no_iterable);
+    p_write = (p_write + n) % pipe_buffer_size;
+    flag = 1;
+    return ret;
+}
+
+static int mypipe_get_user(char __user *buf, size_t n)
+{
+    size_t max_no_iterable = min(n, (size_t)(pipe_buffer_size - p_read));
+    int ret = copy_to_user(buf, kernel_buffer + p_read, max_no_iterable);
+    ret |= copy_to_user(buf + max_no_iterable, kernel_buffer, n - max_no_iterable);
+    p_read = (p_read + n) % pipe_buffer_size;
+    flag = 0;
+    return ret;
+}
+
+static int mypipe_put_iter(struct iov_iter *from, size_t n)
+{
+    size_t max_no_iterable = min(n, (size_t)(pipe_buffer_size - p_write));
+    int ret = copy_from_iter(kernel_buffer + p_write, max_no_iterable, from) != max_no_iterable;
+    ret |= copy_from_iter(kernel_buffer, n - max_no_iterable, from) != n - max_no_iterable;
+    p_write = (p_write + n) % pipe_buffer_size;
+    flag = 1;
+    return ret;
+}
+
+static int mypipe_get_iter(struct iov_iter *to, size_t n)
+{
+    size_t max_no_iterable = min(n, (size_t)(pipe_buffer_size - p_read));
+    int ret = copy_to_iter(kernel_buffer + p_read, max_no_iterable, to) != max_no_iterable;
+    ret |= copy_to_iter(kernel_buffer, n - max_no_iterable, to) != n - max_no_iterable;
+    p_read = (p_read + n) % pipe_buffer_size;
+    flag = 0;
+    return ret;
+}
+
+// the bytes left in the current iovec of a writev
+static size_t mypipe_segment_length(const struct iov_iter *iter)
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 4, 0)
+    return iter_iov_len(iter);
+#else
+    return iov_iter_single_seg_count(iter);
+#endif
+}
+
+// framed read: the whole record at p_read, -EMSGSIZE (keeping it) if it does not fit in count
+static ssize_t mypipe_read_frame(char __user *buf, size_t count)
+{
+    frame_header length;
+    if (mypipe_used() == 0)
+    {
+        return 0;
+    }
+    length = mypipe_peek_header();
+    if (length > count)
+    {
+        return -EMSGSIZE;
+    }
+    p_read = (p_read + sizeof(length)) % pipe_buffer_size;
+    if (mypipe_get_user(buf, length) != 0)
+    {
+        return -EFAULT;
+    }
+    return length;
+}
+
+// whether a record of count bytes can be written: 0, -EINVAL for an empty one (a read of it
+// would look like an empty buffer), -EAGAIN if it does not fit now, -EMSGSIZE if it never will
+static ssize_t mypipe_check_frame(size_t count)
+{
+    if (count == 0)
+    {
+        return -EINVAL;
+    }
+    if (count + sizeof(frame_header) > (size_t)pipe_buffer_size)
+    {
+        return -EMSGSIZE;
+    }
+    if (count + sizeof(frame_header) > pipe_buffer_size - mypipe_used())
+    {
+        return -EAGAIN;
+    }
+    return 0;
+}
+
+// The bytes of a record go in first and its header last, so a copy that faults is rolled
+// back and leaves no partial record: p_write moves past the header, and only when the bytes
+// are in is the header stored at the old p_write.
+static ssize_t mypipe_commit_frame(ssize_t start, int old_flag, size_t count, int copy_failed)
+{
+    if (copy_failed)
+    {
+        p_write = start;
+        flag = old_flag;
+        return -EFAULT;
+    }
+    mypipe_store_header(start, count);
+    return count;
+}
+
+// framed write: one record, or the error of mypipe_check_frame
+static ssize_t mypipe_write_frame(const char __user *buf, size_t count)
+{
+    ssize_t start = p_write;
+    int old_flag = flag;
+    ssize_t ret = mypipe_check_frame(count);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    p_write = (p_write + sizeof(frame_header)) % pipe_buffer_size;
+    return mypipe_commit_frame(start, old_flag, count, mypipe_put_user(buf, count));
+}
+
+// readv: in the stream mode the bytes available, scattered over the iovecs; in the framed
+// mode as many whole records as fit, each still preceded by its length so that the records
+// of the batch can be told apart
+static ssize_t mypipe_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+    ssize_t actual_read_length = 0;
+    ssize_t ret = 0;
+    if (mutex_lock_killable(&mutex_buffer))
+    {
+        return -EINTR;
+    }
+    down(&sem);
+
+    if (!framed)
+    {
+        actual_read_length = min(iov_iter_count(to), mypipe_used());
+        ret = mypipe_get_iter(to, actual_read_length);
+    }
+    else
+    {
+        while (mypipe_used() > 0 && ret == 0)
+        {
+            size_t record = sizeof(frame_header) + mypipe_peek_header();
+            if (record > iov_iter_count(to))
+            {
+                break;
+            }
+            ret = mypipe_get_iter(to, record);
+            actual_read_length += record;
+        }
+        if (actual_read_length == 0 && mypipe_used() > 0)
+        {
+            ret = -EMSGSIZE;
+        }
+    }
+
+    up(&sem);
+    mutex_unlock(&mutex_buffer);
+    if (ret != 0)
+    {
+        return ret < 0 ? ret : -EFAULT;
+    }
+    return actual_read_length;
+}
+
+// writev: in the stream mode the iovecs gathered into as much as fits; in the framed mode
+// each iovec is one record, written in order until one does not fit or is empty
+static ssize_t mypipe_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+    ssize_t actual_write_length = 0;
+    ssize_t ret = 0;
+    if (mutex_lock_killable(&mutex_buffer))
+    {
+        return -EINTR;
+    }
+    down(&sem);
+
+    if (!framed)
+    {
+        actual_write_length = min(iov_iter_count(from), pipe_buffer_size - mypipe_used());
+        ret = mypipe_put_iter(from, actual_write_length);
+    }
+    else
+    {
+        // an empty iovec is no record (see mypipe_check_frame) and stops the batch; copying
+        // nothing would not move the iterator past it
+        while (iov_iter_count(from) > 0)
+        {
+            size_t length = mypipe_segment_length(from);
+            ssize_t start = p_write;
+            int old_flag = flag;
+            ret = mypipe_check_frame(length);
+            if (ret != 0)
+            {
+                break;
+            }
+            p_write = (p_write + sizeof(frame_header)) % pipe_buffer_size;
+            ret = mypipe_commit_frame(start, old_flag, length, mypipe_put_iter(from, length));
+            if (ret < 0)
+            {
+                break;
+            }
+            actual_write_length += length;
+            ret = 0;
+        }
+        if (actual_write_length > 0)
+        {
+            ret = 0; // the records before the one that stopped the batch are written
+        }
+    }
+
+    up(&sem);
+    mutex_unlock(&mutex_buffer);
+    if (ret != 0)
+    {
+        return ret < 0 ? ret : -EFAULT;
+    }
+    return actual_write_length;
+}
+
 static ssize_t mypipe_read(struct file *file, char __user *buf, size_t count, loff_t *f_pos)
 {
     // lock the buffer
@@ -31,6 +296,14 @@ static ssize_t mypipe_read(struct file *file, char __user *buf, size_t count, lo
     int ret = 0;
     down_interruptible(&sem);
 
+    if (framed)
+    {
+        actual_read_length = mypipe_read_frame(buf, count);
+        up(&sem);
+        mutex_unlock(&mutex_buffer);
+        return actual_read_length;
+    }
+
     if (p_read == p_write && flag == 0)
     {
         printk(KERN_WARNING":the buffer is empty and will not be readable until the next write");
@@ -44,8 +317,8 @@ static ssize_t mypipe_read(struct file *file, char __user *buf, size_t count, lo
     }
     else
     {
-        actual_read_length = min(count, PIPE_BUFFER_SIZE - (p_read - p_write));
-        ssize_t max_no_iterable = PIPE_BUFFER_SIZE - p_read;
+        actual_read_length = min(count, pipe_buffer_size - (p_read - p_write));
+        ssize_t max_no_iterable = pipe_buffer_size - p_read;
         if (actual_read_length <= max_no_iterable)
         {
             ret |= copy_to_user(buf, kernel_buffer + p_read, actual_read_length);
@@ -59,7 +332,7 @@ static ssize_t mypipe_read(struct file *file, char __user *buf, size_t count, lo
     
     printk(KERN_INFO":read %zu bytes\n", actual_read_length);
     printk(KERN_INFO":p_read before %zu\n", p_read);
-    p_read = (p_read + actual_read_length) % PIPE_BUFFER_SIZE;
+    p_read = (p_read + actual_read_length) % pipe_buffer_size;
     printk(KERN_INFO":change p_read to %zu\n", p_read);
     
 end_read:
@@ -83,6 +356,14 @@ static ssize_t mypipe_write(struct file *file, const char __user *buf, size_t co
     int ret = 0;
     down_interruptible(&sem);
 
+    if (framed)
+    {
+        actual_write_length = mypipe_write_frame(buf, count);
+        up(&sem);
+        mutex_unlock(&mutex_buffer);
+        return actual_write_length;
+    }
+
     if (p_read == p_write && flag == 1)
     {
         printk(KERN_WARNING":the buffer is full and will not be writeable until the next read");
@@ -97,8 +378,8 @@ static ssize_t mypipe_write(struct file *file, const char __user *buf, size_t co
     }
     else
     {
-        actual_write_length = min(count, PIPE_BUFFER_SIZE - (p_write - p_read));
-        ssize_t max_no_iterable = PIPE_BUFFER_SIZE - p_write;
+        actual_write_length = min(count, pipe_buffer_size - (p_write - p_read));
+        ssize_t max_no_iterable = pipe_buffer_size - p_write;
         if (actual_write_length <= max_no_iterable)
         {
             ret |= copy_from_user(kernel_buffer + p_write, buf, actual_write_length);
@@ -112,7 +393,7 @@ static ssize_t mypipe_write(struct file *file, const char __user *buf, size_t co
     
     printk(KERN_INFO":write %zu bytes\n", actual_write_length);
     printk(KERN_INFO":p_write before %zu\n", p_write);
-    p_write = (p_write + actual_write_length) % PIPE_BUFFER_SIZE;
+    p_write = (p_write + actual_write_length) % pipe_buffer_size;
     printk(KERN_INFO":change p_write to %zu\n", p_write);
 
 end_write:
@@ -143,6 +424,8 @@ static struct file_operations mypipe_fops = {
     .owner = THIS_MODULE,
     .read = mypipe_read,
     .write = mypipe_write,
+    .read_iter = mypipe_read_iter,
+    .write_iter = mypipe_write_iter,
     .open = mypipe_open,
     .release = mypipe_release
 };
@@ -150,9 +433,13 @@ static struct file_operations mypipe_fops = {
 static int __init mypipe_init(void)
 {
     int ret;
+    pipe_buffer_size = buffer_size ? buffer_size : framed ? FRAMED_BUFFER_SIZE : PIPE_BUFFER_SIZE;
+    kernel_buffer = kvzalloc(pipe_buffer_size, GFP_KERNEL);
+    if (!kernel_buffer)
+    {
+        return -ENOMEM;
+    }
     ret = register_chrdev(PIPE_NUMBER, "mypipe", &mypipe_fops);
-    kernel_buffer = kmalloc(PIPE_BUFFER_SIZE, GFP_KERNEL);
-    memset(kernel_buffer, 0, PIPE_BUFFER_SIZE);
     mutex_init(&mutex_buffer);
     sema_init(&sem, 1);
     printk(KERN_INFO":mypipe register successfully\n");
@@ -162,7 +449,7 @@ static int __init mypipe_init(void)
 static void __exit mypipe_exit(void)
 {
     unregister_chrdev(PIPE_NUMBER, "mypipe");
-    kfree(kernel_buffer);
+    kvfree(kernel_buffer);
     sema_init(&sem, 0);
     mutex_destroy(&mutex_buffer);
     printk(KERN_INFO":mypipe unregister successfully\n");
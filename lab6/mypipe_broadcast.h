@@ -0,0 +1,275 @@
+#ifndef MYPIPE_BROADCAST_H
+#define MYPIPE_BROADCAST_H
+
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// A broadcast variant of the mypipe ring: every reader receives every record. Instead of
+// one p_read, each reader has its own cursor, and writers only reuse the bytes that the
+// slowest reader has passed (slowest-reader flow control). Several writers can write at
+// once without a lock: each reserves the span of its records by moving `claimed` with a
+// compare-and-swap, copies into it on its own, and then publishes every record by marking
+// its start in `available` with the lap it belongs to. A reader waits on the mark at its
+// cursor (the sequence barrier), so it never sees a record that is only reserved or one
+// left from an earlier lap, and a writer that is slow to finish holds up only the readers
+// that reach its record, not the other writers.
+//
+// Positions are byte counts since the start and only grow. Records start at multiples of 8
+// and the size is a multiple of 8, so a header never wraps. The ring may live in shared
+// memory and be used by several processes; waiting spins briefly, then yields the CPU.
+
+#define MYPIPE_BROADCAST_MAX_READERS 64
+#define MYPIPE_BROADCAST_ALIGN 8
+#define MYPIPE_BROADCAST_CACHE_LINE 64
+
+// a position on a cache line of its own
+struct mypipe_cursor
+{
+    _Atomic size_t value __attribute__((aligned(MYPIPE_BROADCAST_CACHE_LINE)));
+};
+
+struct mypipe_broadcast
+{
+    struct mypipe_cursor claimed; // the end of the last reservation
+    struct mypipe_cursor gating; // the slowest reader cursor the writers last saw
+    size_t size; // the size of the buffer
+    int reader_num;
+    struct mypipe_cursor readers[MYPIPE_BROADCAST_MAX_READERS]; // where each reader reads next
+    char buffer[] __attribute__((aligned(MYPIPE_BROADCAST_CACHE_LINE))); // then `available`
+};
+
+typedef uint64_t mypipe_broadcast_header; // the length of the record that follows
+
+// the bytes a record of `count` bytes takes, its header and padding included
+static inline size_t mypipe_broadcast_record(size_t count)
+{
+    size_t record = sizeof(mypipe_broadcast_header) + count;
+    return (record + MYPIPE_BROADCAST_ALIGN - 1) / MYPIPE_BROADCAST_ALIGN * MYPIPE_BROADCAST_ALIGN;
+}
+
+// the number of bytes to allocate for a ring with `size` bytes of buffer
+static inline size_t mypipe_broadcast_bytes(size_t size)
+{
+    return sizeof(struct mypipe_broadcast) + size + size / MYPIPE_BROADCAST_ALIGN * sizeof(uint32_t);
+}
+
+// `available` holds a mark per 8 bytes of buffer, 1 + the lap of the record published there;
+// this is the mark of a record published at position
+static inline uint32_t mypipe_broadcast_lap(const struct mypipe_broadcast *ring, size_t position)
+{
+    return (uint32_t)(position / ring->size) + 1;
+}
+
+static inline _Atomic uint32_t *mypipe_broadcast_mark(struct mypipe_broadcast *ring, size_t position)
+{
+    _Atomic uint32_t *available = (_Atomic uint32_t *)(ring->buffer + ring->size);
+    return available + position % ring->size / MYPIPE_BROADCAST_ALIGN;
+}
+
+// size must be a multiple of 8; returns -EINVAL for a bad size or reader number
+static inline int mypipe_broadcast_init(struct mypipe_broadcast *ring, size_t size, int reader_num)
+{
+    if (size == 0 || size % MYPIPE_BROADCAST_ALIGN != 0 || reader_num < 1 || reader_num > MYPIPE_BROADCAST_MAX_READERS)
+    {
+        return -EINVAL;
+    }
+    ring->size = size;
+    ring->reader_num = reader_num;
+    atomic_init(&ring->claimed.value, 0);
+    atomic_init(&ring->gating.value, 0);
+    for (int i = 0; i < MYPIPE_BROADCAST_MAX_READERS; i++)
+    {
+        atomic_init(&ring->readers[i].value, 0);
+    }
+    for (size_t position = 0; position < size; position += MYPIPE_BROADCAST_ALIGN)
+    {
+        atomic_init(mypipe_broadcast_mark(ring, position), 0);
+    }
+    return 0;
+}
+
+// spins `*spins` times, then yields the CPU on every call
+static inline void mypipe_broadcast_pause(int *spins)
+{
+    if (++*spins > 64)
+    {
+        sched_yield();
+    }
+}
+
+// the slowest reader cursor
+static inline size_t mypipe_broadcast_slowest(struct mypipe_broadcast *ring)
+{
+    size_t slowest = atomic_load_explicit(&ring->readers[0].value, memory_order_acquire);
+    for (int i = 1; i < ring->reader_num; i++)
+    {
+        size_t cursor = atomic_load_explicit(&ring->readers[i].value, memory_order_acquire);
+        if (cursor < slowest)
+        {
+            slowest = cursor;
+        }
+    }
+    return slowest;
+}
+
+// reserve `bytes` of records for this writer; returns the position of the span, -EAGAIN if
+// the slowest reader leaves no room yet, -EMSGSIZE if it never will
+static inline ssize_t mypipe_broadcast_reserve(struct mypipe_broadcast *ring, size_t bytes)
+{
+    if (bytes > ring->size)
+    {
+        return -EMSGSIZE;
+    }
+    size_t claimed = atomic_load_explicit(&ring->claimed.value, memory_order_relaxed);
+    do
+    {
+        // the cached gating cursor is only refreshed when it seems to leave no room
+        size_t gating = atomic_load_explicit(&ring->gating.value, memory_order_acquire);
+        if (claimed + bytes - gating > ring->size)
+        {
+            gating = mypipe_broadcast_slowest(ring);
+            atomic_store_explicit(&ring->gating.value, gating, memory_order_release);
+            if (claimed + bytes - gating > ring->size)
+            {
+                return -EAGAIN;
+            }
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&ring->claimed.value, &claimed, claimed + bytes, memory_order_acq_rel, memory_order_relaxed));
+    return claimed;
+}
+
+// copy a record into a reserved position and publish it; returns the position after it
+static inline size_t mypipe_broadcast_put(struct mypipe_broadcast *ring, size_t position, const char *buf, size_t count)
+{
+    size_t offset = (position + sizeof(mypipe_broadcast_header)) % ring->size;
+    size_t max_no_iterable = ring->size - offset;
+    if (count <= max_no_iterable)
+    {
+        memcpy(ring->buffer + offset, buf, count);
+    }
+    else
+    {
+        memcpy(ring->buffer + offset, buf, max_no_iterable);
+        memcpy(ring->buffer, buf + max_no_iterable, count - max_no_iterable);
+    }
+    mypipe_broadcast_header length = count;
+    memcpy(ring->buffer + position % ring->size, &length, sizeof(length));
+    atomic_store_explicit(mypipe_broadcast_mark(ring, position), mypipe_broadcast_lap(ring, position), memory_order_release);
+    return position + mypipe_broadcast_record(count);
+}
+
+// non-blocking write of one record: `count`, or -EAGAIN / -EMSGSIZE as for the reservation
+static inline ssize_t mypipe_broadcast_write(struct mypipe_broadcast *ring, const char *buf, size_t count)
+{
+    ssize_t position = mypipe_broadcast_reserve(ring, mypipe_broadcast_record(count));
+    if (position < 0)
+    {
+        return position;
+    }
+    mypipe_broadcast_put(ring, position, buf, count);
+    return count;
+}
+
+// non-blocking write of one record per iovec with a single reservation, of as many leading
+// records as the ring can hold; returns their number, -EAGAIN if they do not fit yet, or
+// -EMSGSIZE if the first one never will
+static inline ssize_t mypipe_broadcast_writev(struct mypipe_broadcast *ring, const struct iovec *iov, int iovcnt)
+{
+    size_t bytes = 0;
+    int record_num = 0;
+    while (record_num < iovcnt && bytes + mypipe_broadcast_record(iov[record_num].iov_len) <= ring->size)
+    {
+        bytes += mypipe_broadcast_record(iov[record_num].iov_len);
+        record_num++;
+    }
+    if (record_num == 0)
+    {
+        return -EMSGSIZE;
+    }
+
+    ssize_t position = mypipe_broadcast_reserve(ring, bytes);
+    if (position < 0)
+    {
+        return position;
+    }
+    for (int i = 0; i < record_num; i++)
+    {
+        position = mypipe_broadcast_put(ring, position, (const char *)iov[i].iov_base, iov[i].iov_len);
+    }
+    return record_num;
+}
+
+// non-blocking read of the next record for `reader`: its length, -EAGAIN if it is not
+// published yet, -EMSGSIZE (keeping it) if it does not fit in count
+static inline ssize_t mypipe_broadcast_read(struct mypipe_broadcast *ring, int reader, char *buf, size_t count)
+{
+    size_t cursor = atomic_load_explicit(&ring->readers[reader].value, memory_order_relaxed);
+    if (atomic_load_explicit(mypipe_broadcast_mark(ring, cursor), memory_order_acquire) != mypipe_broadcast_lap(ring, cursor))
+    {
+        return -EAGAIN;
+    }
+    mypipe_broadcast_header length;
+    memcpy(&length, ring->buffer + cursor % ring->size, sizeof(length));
+    if (length > count)
+    {
+        return -EMSGSIZE;
+    }
+
+    size_t offset = (cursor + sizeof(mypipe_broadcast_header)) % ring->size;
+    size_t max_no_iterable = ring->size - offset;
+    if (length <= max_no_iterable)
+    {
+        memcpy(buf, ring->buffer + offset, length);
+    }
+    else
+    {
+        memcpy(buf, ring->buffer + offset, max_no_iterable);
+        memcpy(buf + max_no_iterable, ring->buffer, length - max_no_iterable);
+    }
+    // the writers may reuse the record once every cursor has passed it
+    atomic_store_explicit(&ring->readers[reader].value, cursor + mypipe_broadcast_record(length), memory_order_release);
+    return length;
+}
+
+// blocking write, waits until the slowest reader leaves room for the record
+static inline ssize_t mypipe_broadcast_write_wait(struct mypipe_broadcast *ring, const char *buf, size_t count)
+{
+    int spins = 0;
+    ssize_t n;
+    while ((n = mypipe_broadcast_write(ring, buf, count)) == -EAGAIN)
+    {
+        mypipe_broadcast_pause(&spins);
+    }
+    return n;
+}
+
+// blocking writev, waits until at least the first record fits
+static inline ssize_t mypipe_broadcast_writev_wait(struct mypipe_broadcast *ring, const struct iovec *iov, int iovcnt)
+{
+    int spins = 0;
+    ssize_t n;
+    while ((n = mypipe_broadcast_writev(ring, iov, iovcnt)) == -EAGAIN)
+    {
+        mypipe_broadcast_pause(&spins);
+    }
+    return n;
+}
+
+// blocking read, waits until the next record is published
+static inline ssize_t mypipe_broadcast_read_wait(struct mypipe_broadcast *ring, int reader, char *buf, size_t count)
+{
+    int spins = 0;
+    ssize_t n;
+    while ((n = mypipe_broadcast_read(ring, reader, buf, count)) == -EAGAIN)
+    {
+        mypipe_broadcast_pause(&spins);
+    }
+    return n;
+}
+
+#endif // !MYPIPE_BROADCAST_H
@@ -0,0 +1,412 @@
+#ifndef MYPIPE_RING_H
+#define MYPIPE_RING_H
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+// userspace copy of the ring buffer in mypipe.c, so that the driver logic
+// can be benchmarked without loading the module
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+struct mypipe_ring
+{
+    size_t size; // the size of the buffer
+    size_t p_read; // the pointer to read
+    size_t p_write; // the pointer to write
+    int flag; // whether the buffer is empty or full
+    pthread_mutex_t mutex_buffer;
+    pthread_cond_t readable; // signaled after every write
+    pthread_cond_t writable; // signaled after every read
+    char buffer[];
+};
+
+// the number of bytes to allocate for a ring with `size` bytes of buffer
+static inline size_t mypipe_ring_bytes(size_t size)
+{
+    return sizeof(struct mypipe_ring) + size;
+}
+
+// `shared` makes the lock usable by several processes when the ring lives in shared memory
+static inline void mypipe_ring_init(struct mypipe_ring *ring, size_t size, int shared)
+{
+    pthread_mutexattr_t mutex_attr;
+    pthread_condattr_t cond_attr;
+    pthread_mutexattr_init(&mutex_attr);
+    pthread_condattr_init(&cond_attr);
+    if (shared)
+    {
+        pthread_mutexattr_setpshared(&mutex_attr, PTHREAD_PROCESS_SHARED);
+        pthread_condattr_setpshared(&cond_attr, PTHREAD_PROCESS_SHARED);
+    }
+
+    ring->size = size;
+    ring->p_read = 0;
+    ring->p_write = 0;
+    ring->flag = 0;
+    pthread_mutex_init(&ring->mutex_buffer, &mutex_attr);
+    pthread_cond_init(&ring->readable, &cond_attr);
+    pthread_cond_init(&ring->writable, &cond_attr);
+    memset(ring->buffer, 0, size);
+
+    pthread_mutexattr_destroy(&mutex_attr);
+    pthread_condattr_destroy(&cond_attr);
+}
+
+static inline void mypipe_ring_destroy(struct mypipe_ring *ring)
+{
+    pthread_mutex_destroy(&ring->mutex_buffer);
+    pthread_cond_destroy(&ring->readable);
+    pthread_cond_destroy(&ring->writable);
+}
+
+static inline int mypipe_ring_empty(const struct mypipe_ring *ring)
+{
+    return ring->p_read == ring->p_write && ring->flag == 0;
+}
+
+static inline int mypipe_ring_full(const struct mypipe_ring *ring)
+{
+    return ring->p_read == ring->p_write && ring->flag == 1;
+}
+
+// the body of mypipe_read, the caller must hold mutex_buffer
+static inline ssize_t mypipe_ring_read_locked(struct mypipe_ring *ring, char *buf, size_t count)
+{
+    ssize_t actual_read_length = 0;
+
+    if (mypipe_ring_empty(ring))
+    {
+        return 0;
+    }
+
+    if (ring->p_read < ring->p_write)
+    {
+        actual_read_length = min(count, ring->p_write - ring->p_read);
+        memcpy(buf, ring->buffer + ring->p_read, actual_read_length);
+    }
+    else
+    {
+        actual_read_length = min(count, ring->size - (ring->p_read - ring->p_write));
+        ssize_t max_no_iterable = ring->size - ring->p_read;
+        if (actual_read_length <= max_no_iterable)
+        {
+            memcpy(buf, ring->buffer + ring->p_read, actual_read_length);
+        }
+        else
+        {
+            memcpy(buf, ring->buffer + ring->p_read, max_no_iterable);
+            memcpy(buf + max_no_iterable, ring->buffer, actual_read_length - max_no_iterable);
+        }
+    }
+
+    ring->p_read = (ring->p_read + actual_read_length) % ring->size;
+    ring->flag = 0;
+    return actual_read_length;
+}
+
+// the body of mypipe_write, the caller must hold mutex_buffer
+static inline ssize_t mypipe_ring_write_locked(struct mypipe_ring *ring, const char *buf, size_t count)
+{
+    ssize_t actual_write_length = 0;
+
+    if (mypipe_ring_full(ring))
+    {
+        return 0;
+    }
+
+    if (ring->p_read > ring->p_write)
+    {
+        actual_write_length = min(count, ring->p_read - ring->p_write);
+        memcpy(ring->buffer + ring->p_write, buf, actual_write_length);
+    }
+    else
+    {
+        actual_write_length = min(count, ring->size - (ring->p_write - ring->p_read));
+        ssize_t max_no_iterable = ring->size - ring->p_write;
+        if (actual_write_length <= max_no_iterable)
+        {
+            memcpy(ring->buffer + ring->p_write, buf, actual_write_length);
+        }
+        else
+        {
+            memcpy(ring->buffer + ring->p_write, buf, max_no_iterable);
+            memcpy(ring->buffer, buf + max_no_iterable, actual_write_length - max_no_iterable);
+        }
+    }
+
+    ring->p_write = (ring->p_write + actual_write_length) % ring->size;
+    if (actual_write_length > 0)
+    {
+        ring->flag = 1;
+    }
+    return actual_write_length;
+}
+
+// framed mode, as the driver loaded with framed=1: a record is its length followed by its
+// bytes, written whole or not at all; like the driver, a record that does not fit now gives
+// -EAGAIN, one that never fits -EMSGSIZE, an empty one -EINVAL, and an empty ring reads as 0
+
+typedef uint32_t mypipe_frame_header; // the length of the record that follows
+
+static inline size_t mypipe_ring_used(const struct mypipe_ring *ring)
+{
+    if (ring->p_read == ring->p_write)
+    {
+        return ring->flag ? ring->size : 0;
+    }
+    return (ring->p_write - ring->p_read + ring->size) % ring->size;
+}
+
+// the length of the record at position, which must hold one
+static inline mypipe_frame_header mypipe_ring_peek_header(const struct mypipe_ring *ring, size_t position)
+{
+    mypipe_frame_header length;
+    size_t max_no_iterable = min(sizeof(length), ring->size - position);
+    memcpy(&length, ring->buffer + position, max_no_iterable);
+    memcpy((char *)&length + max_no_iterable, ring->buffer, sizeof(length) - max_no_iterable);
+    return length;
+}
+
+// the body of the framed mypipe_read, the caller must hold mutex_buffer
+static inline ssize_t mypipe_ring_read_frame_locked(struct mypipe_ring *ring, char *buf, size_t count)
+{
+    if (mypipe_ring_empty(ring))
+    {
+        return 0;
+    }
+    mypipe_frame_header length = mypipe_ring_peek_header(ring, ring->p_read);
+    if (length > count)
+    {
+        return -EMSGSIZE;
+    }
+    ring->p_read = (ring->p_read + sizeof(length)) % ring->size;
+    ring->flag = 0;
+    return mypipe_ring_read_locked(ring, buf, length);
+}
+
+// the body of the framed mypipe_write, the caller must hold mutex_buffer
+static inline ssize_t mypipe_ring_write_frame_locked(struct mypipe_ring *ring, const char *buf, size_t count)
+{
+    mypipe_frame_header length = count;
+    if (count == 0)
+    {
+        return -EINVAL;
+    }
+    if (count + sizeof(length) > ring->size)
+    {
+        return -EMSGSIZE;
+    }
+    if (count + sizeof(length) > ring->size - mypipe_ring_used(ring))
+    {
+        return -EAGAIN;
+    }
+    mypipe_ring_write_locked(ring, (const char *)&length, sizeof(length));
+    mypipe_ring_write_locked(ring, buf, count);
+    return count;
+}
+
+// readv: up to `limit` bytes scattered over the iovecs
+static inline ssize_t mypipe_ring_scatter_locked(struct mypipe_ring *ring, const struct iovec *iov, int iovcnt, size_t limit)
+{
+    ssize_t actual_read_length = 0;
+    for (int i = 0; i < iovcnt && (size_t)actual_read_length < limit; i++)
+    {
+        actual_read_length += mypipe_ring_read_locked(ring, (char *)iov[i].iov_base, min(iov[i].iov_len, limit - actual_read_length));
+    }
+    return actual_read_length;
+}
+
+// the body of mypipe_read_iter in the stream mode
+static inline ssize_t mypipe_ring_readv_locked(struct mypipe_ring *ring, const struct iovec *iov, int iovcnt)
+{
+    return mypipe_ring_scatter_locked(ring, iov, iovcnt, mypipe_ring_used(ring));
+}
+
+// the body of mypipe_write_iter in the stream mode
+static inline ssize_t mypipe_ring_writev_locked(struct mypipe_ring *ring, const struct iovec *iov, int iovcnt)
+{
+    ssize_t actual_write_length = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        ssize_t n = mypipe_ring_write_locked(ring, (const char *)iov[i].iov_base, iov[i].iov_len);
+        actual_write_length += n;
+        if ((size_t)n < iov[i].iov_len)
+        {
+            break;
+        }
+    }
+    return actual_write_length;
+}
+
+// the body of mypipe_read_iter in the framed mode: as many whole records as fit, each still
+// preceded by its length
+static inline ssize_t mypipe_ring_readv_frames_locked(struct mypipe_ring *ring, const struct iovec *iov, int iovcnt)
+{
+    size_t space = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        space += iov[i].iov_len;
+    }
+    size_t used = mypipe_ring_used(ring);
+    size_t batch = 0;
+    while (batch < used)
+    {
+        size_t record = sizeof(mypipe_frame_header) + mypipe_ring_peek_header(ring, (ring->p_read + batch) % ring->size);
+        if (batch + record > space)
+        {
+            break;
+        }
+        batch += record;
+    }
+    if (batch == 0 && used > 0)
+    {
+        return -EMSGSIZE;
+    }
+    return mypipe_ring_scatter_locked(ring, iov, iovcnt, batch);
+}
+
+// the body of mypipe_write_iter in the framed mode: one record per iovec, in order until
+// one does not fit or is empty; returns the bytes of the records written
+static inline ssize_t mypipe_ring_writev_frames_locked(struct mypipe_ring *ring, const struct iovec *iov, int iovcnt)
+{
+    ssize_t actual_write_length = 0;
+    for (int i = 0; i < iovcnt; i++)
+    {
+        ssize_t n = mypipe_ring_write_frame_locked(ring, (const char *)iov[i].iov_base, iov[i].iov_len);
+        if (n < 0)
+        {
+            return actual_write_length > 0 ? actual_write_length : n;
+        }
+        actual_write_length += n;
+    }
+    return actual_write_length;
+}
+
+// non-blocking read, returns 0 when the buffer is empty (like the driver)
+static inline ssize_t mypipe_ring_read(struct mypipe_ring *ring, char *buf, size_t count)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    ssize_t actual_read_length = mypipe_ring_read_locked(ring, buf, count);
+    if (actual_read_length > 0)
+    {
+        pthread_cond_signal(&ring->writable);
+    }
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_read_length;
+}
+
+// non-blocking write, returns 0 when the buffer is full
+static inline ssize_t mypipe_ring_write(struct mypipe_ring *ring, const char *buf, size_t count)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    ssize_t actual_write_length = mypipe_ring_write_locked(ring, buf, count);
+    if (actual_write_length > 0)
+    {
+        pthread_cond_signal(&ring->readable);
+    }
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_write_length;
+}
+
+// blocking read, waits until at least one byte is available
+static inline ssize_t mypipe_ring_read_wait(struct mypipe_ring *ring, char *buf, size_t count)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    while (mypipe_ring_empty(ring))
+    {
+        pthread_cond_wait(&ring->readable, &ring->mutex_buffer);
+    }
+    ssize_t actual_read_length = mypipe_ring_read_locked(ring, buf, count);
+    pthread_cond_signal(&ring->writable);
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_read_length;
+}
+
+// blocking write, waits until at least one byte can be written
+static inline ssize_t mypipe_ring_write_wait(struct mypipe_ring *ring, const char *buf, size_t count)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    while (mypipe_ring_full(ring))
+    {
+        pthread_cond_wait(&ring->writable, &ring->mutex_buffer);
+    }
+    ssize_t actual_write_length = mypipe_ring_write_locked(ring, buf, count);
+    pthread_cond_signal(&ring->readable);
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_write_length;
+}
+
+// blocking framed read, waits until a record is available
+static inline ssize_t mypipe_ring_read_frame_wait(struct mypipe_ring *ring, char *buf, size_t count)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    while (mypipe_ring_empty(ring))
+    {
+        pthread_cond_wait(&ring->readable, &ring->mutex_buffer);
+    }
+    ssize_t actual_read_length = mypipe_ring_read_frame_locked(ring, buf, count);
+    pthread_cond_signal(&ring->writable);
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_read_length;
+}
+
+// blocking framed write, waits until the whole record fits
+static inline ssize_t mypipe_ring_write_frame_wait(struct mypipe_ring *ring, const char *buf, size_t count)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    ssize_t actual_write_length;
+    while ((actual_write_length = mypipe_ring_write_frame_locked(ring, buf, count)) == -EAGAIN)
+    {
+        pthread_cond_wait(&ring->writable, &ring->mutex_buffer);
+    }
+    pthread_cond_signal(&ring->readable);
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_write_length;
+}
+
+// blocking readv, waits until at least one byte (or, framed, one record) is available
+static inline ssize_t mypipe_ring_readv_wait(struct mypipe_ring *ring, const struct iovec *iov, int iovcnt, int framed)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    while (mypipe_ring_empty(ring))
+    {
+        pthread_cond_wait(&ring->readable, &ring->mutex_buffer);
+    }
+    ssize_t actual_read_length = framed ? mypipe_ring_readv_frames_locked(ring, iov, iovcnt) : mypipe_ring_readv_locked(ring, iov, iovcnt);
+    pthread_cond_signal(&ring->writable);
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_read_length;
+}
+
+// blocking writev, waits until at least one byte (or, framed, the first record) fits
+static inline ssize_t mypipe_ring_writev_wait(struct mypipe_ring *ring, const struct iovec *iov, int iovcnt, int framed)
+{
+    pthread_mutex_lock(&ring->mutex_buffer);
+    ssize_t actual_write_length;
+    if (framed)
+    {
+        while ((actual_write_length = mypipe_ring_writev_frames_locked(ring, iov, iovcnt)) == -EAGAIN)
+        {
+            pthread_cond_wait(&ring->writable, &ring->mutex_buffer);
+        }
+    }
+    else
+    {
+        while (mypipe_ring_full(ring))
+        {
+            pthread_cond_wait(&ring->writable, &ring->mutex_buffer);
+        }
+        actual_write_length = mypipe_ring_writev_locked(ring, iov, iovcnt);
+    }
+    pthread_cond_signal(&ring->readable);
+    pthread_mutex_unlock(&ring->mutex_buffer);
+    return actual_write_length;
+}
+
+#endif // !MYPIPE_RING_H
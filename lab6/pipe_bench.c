@@ -0,0 +1,649 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "mypipe_ring.h"
+
+// stream messages from a writer process to a reader process over one transport,
+// reporting throughput and per-message latency percentiles
+//
+// usage: ./pipe_bench [-t mypipe|pipe|socketpair|shm] [-s message_size] [-n message_number]
+//                     [-b ring_size] [-w writer_cpu] [-r reader_cpu] [-c] [-f] [-v batch]
+//
+// -f sends every message as a record of the framed mypipe, -v moves `batch` messages per
+// writev/readv call instead of one per write/read
+
+#define DEFAULT_RING_SIZE 65536
+#define CACHE_LINE_SIZE 64
+#define MAX_BATCH 1024 // IOV_MAX
+
+enum transport_type
+{
+    TRANSPORT_MYPIPE,
+    TRANSPORT_PIPE,
+    TRANSPORT_SOCKETPAIR,
+    TRANSPORT_SHM
+};
+
+static const char *transport_names[] = {"mypipe", "pipe", "socketpair", "shm"};
+
+// every message begins with this header, the rest is filled with a pattern derived from seq
+struct message_header
+{
+    uint64_t seq;
+    uint64_t send_ns;
+};
+
+// a single-producer single-consumer lock-free byte ring, living in shared memory
+struct shm_ring
+{
+    _Atomic size_t head __attribute__((aligned(CACHE_LINE_SIZE))); // total bytes written
+    _Atomic size_t tail __attribute__((aligned(CACHE_LINE_SIZE))); // total bytes read
+    size_t size __attribute__((aligned(CACHE_LINE_SIZE)));
+    char buffer[];
+};
+
+struct transport
+{
+    enum transport_type type;
+    int fds[2]; // for pipe and socketpair, [0] is read end and [1] is write end
+    void *shared; // for mypipe and shm
+    size_t shared_bytes;
+};
+
+struct options
+{
+    enum transport_type type;
+    size_t message_size;
+    long message_number;
+    size_t ring_size;
+    int writer_cpu;
+    int reader_cpu;
+    int check_payload;
+    int framed;
+    int batch;
+};
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static void pin_to_cpu(int cpu)
+{
+    if (cpu < 0)
+    {
+        return;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0)
+    {
+        perror("[WARNING] Fail to pin to cpu");
+    }
+}
+
+static ssize_t shm_ring_write(struct shm_ring *ring, const char *buf, size_t count)
+{
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    size_t actual_write_length = min(count, ring->size - (head - tail));
+    size_t offset = head % ring->size;
+    size_t max_no_iterable = min(actual_write_length, ring->size - offset);
+    memcpy(ring->buffer + offset, buf, max_no_iterable);
+    memcpy(ring->buffer, buf + max_no_iterable, actual_write_length - max_no_iterable);
+    atomic_store_explicit(&ring->head, head + actual_write_length, memory_order_release);
+    return actual_write_length;
+}
+
+static ssize_t shm_ring_read(struct shm_ring *ring, char *buf, size_t count)
+{
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t actual_read_length = min(count, head - tail);
+    size_t offset = tail % ring->size;
+    size_t max_no_iterable = min(actual_read_length, ring->size - offset);
+    memcpy(buf, ring->buffer + offset, max_no_iterable);
+    memcpy(buf + max_no_iterable, ring->buffer, actual_read_length - max_no_iterable);
+    atomic_store_explicit(&ring->tail, tail + actual_read_length, memory_order_release);
+    return actual_read_length;
+}
+
+static int transport_open(struct transport *t, const struct options *opt)
+{
+    t->type = opt->type;
+    t->shared = NULL;
+    switch (t->type)
+    {
+    case TRANSPORT_PIPE:
+        return pipe(t->fds);
+    case TRANSPORT_SOCKETPAIR:
+        return socketpair(AF_UNIX, SOCK_STREAM, 0, t->fds);
+    case TRANSPORT_MYPIPE:
+        t->shared_bytes = mypipe_ring_bytes(opt->ring_size);
+        break;
+    case TRANSPORT_SHM:
+        t->shared_bytes = sizeof(struct shm_ring) + opt->ring_size;
+        break;
+    }
+
+    t->shared = mmap(NULL, t->shared_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (t->shared == MAP_FAILED)
+    {
+        return -1;
+    }
+    if (t->type == TRANSPORT_MYPIPE)
+    {
+        mypipe_ring_init((struct mypipe_ring *)t->shared, opt->ring_size, 1);
+    }
+    else
+    {
+        struct shm_ring *ring = (struct shm_ring *)t->shared;
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        ring->size = opt->ring_size;
+    }
+    return 0;
+}
+
+static void transport_close(struct transport *t)
+{
+    if (t->shared != NULL)
+    {
+        if (t->type == TRANSPORT_MYPIPE)
+        {
+            mypipe_ring_destroy((struct mypipe_ring *)t->shared);
+        }
+        munmap(t->shared, t->shared_bytes);
+    }
+    else
+    {
+        close(t->fds[0]);
+        close(t->fds[1]);
+    }
+}
+
+// blocks until `count` bytes have been sent
+static int send_all(struct transport *t, const char *buf, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t n = 0;
+        switch (t->type)
+        {
+        case TRANSPORT_PIPE:
+        case TRANSPORT_SOCKETPAIR:
+            n = write(t->fds[1], buf, count);
+            if (n < 0 && errno == EINTR)
+            {
+                n = 0;
+            }
+            break;
+        case TRANSPORT_MYPIPE:
+            n = mypipe_ring_write_wait((struct mypipe_ring *)t->shared, buf, count);
+            break;
+        case TRANSPORT_SHM:
+            n = shm_ring_write((struct shm_ring *)t->shared, buf, count);
+            if (n == 0)
+            {
+                sched_yield();
+            }
+            break;
+        }
+        if (n < 0)
+        {
+            return -1;
+        }
+        buf += n;
+        count -= n;
+    }
+    return 0;
+}
+
+// blocks until `count` bytes have been received
+static int recv_all(struct transport *t, char *buf, size_t count)
+{
+    while (count > 0)
+    {
+        ssize_t n = 0;
+        switch (t->type)
+        {
+        case TRANSPORT_PIPE:
+        case TRANSPORT_SOCKETPAIR:
+            n = read(t->fds[0], buf, count);
+            if (n == 0)
+            {
+                return -1; // the writer is gone
+            }
+            if (n < 0 && errno == EINTR)
+            {
+                n = 0;
+            }
+            break;
+        case TRANSPORT_MYPIPE:
+            n = mypipe_ring_read_wait((struct mypipe_ring *)t->shared, buf, count);
+            break;
+        case TRANSPORT_SHM:
+            n = shm_ring_read((struct shm_ring *)t->shared, buf, count);
+            if (n == 0)
+            {
+                sched_yield();
+            }
+            break;
+        }
+        if (n < 0)
+        {
+            return -1;
+        }
+        buf += n;
+        count -= n;
+    }
+    return 0;
+}
+
+// drops the first n bytes of an iovec array
+static struct iovec *iov_advance(struct iovec *iov, int *iovcnt, size_t n)
+{
+    while (*iovcnt > 0 && n >= iov->iov_len)
+    {
+        n -= iov->iov_len;
+        iov++;
+        (*iovcnt)--;
+    }
+    if (*iovcnt > 0)
+    {
+        iov->iov_base = (char *)iov->iov_base + n;
+        iov->iov_len -= n;
+    }
+    return iov;
+}
+
+// blocks until every iovec has been sent, one record per iovec when framed
+static int send_batch(struct transport *t, struct iovec *iov, int iovcnt, int framed)
+{
+    while (iovcnt > 0)
+    {
+        ssize_t n = -1;
+        switch (t->type)
+        {
+        case TRANSPORT_PIPE:
+        case TRANSPORT_SOCKETPAIR:
+            n = writev(t->fds[1], iov, iovcnt);
+            if (n < 0 && errno == EINTR)
+            {
+                n = 0;
+            }
+            break;
+        case TRANSPORT_MYPIPE:
+            n = mypipe_ring_writev_wait((struct mypipe_ring *)t->shared, iov, iovcnt, framed);
+            break;
+        case TRANSPORT_SHM:
+            break; // rejected by main
+        }
+        if (n < 0)
+        {
+            return -1;
+        }
+        iov = iov_advance(iov, &iovcnt, n);
+    }
+    return 0;
+}
+
+// blocks until `number` messages of `size` bytes have been received into buf; a framed
+// readv returns whole records with their lengths, which are checked and stripped here
+static int recv_batch(struct transport *t, char *buf, size_t size, int number, int framed, char *wire)
+{
+    if (!framed)
+    {
+        struct iovec iov[MAX_BATCH];
+        for (int i = 0; i < number; i++)
+        {
+            iov[i].iov_base = buf + i * size;
+            iov[i].iov_len = size;
+        }
+        struct iovec *next = iov;
+        int iovcnt = number;
+        while (iovcnt > 0)
+        {
+            ssize_t n = -1;
+            if (t->type == TRANSPORT_MYPIPE)
+            {
+                n = mypipe_ring_readv_wait((struct mypipe_ring *)t->shared, next, iovcnt, 0);
+            }
+            else
+            {
+                n = readv(t->fds[0], next, iovcnt);
+                if (n == 0)
+                {
+                    return -1; // the writer is gone
+                }
+                if (n < 0 && errno == EINTR)
+                {
+                    n = 0;
+                }
+            }
+            if (n < 0)
+            {
+                return -1;
+            }
+            next = iov_advance(next, &iovcnt, n);
+        }
+        return 0;
+    }
+
+    size_t record = sizeof(mypipe_frame_header) + size;
+    int received = 0;
+    while (received < number)
+    {
+        struct iovec iov = {wire, (number - received) * record};
+        ssize_t n = mypipe_ring_readv_wait((struct mypipe_ring *)t->shared, &iov, 1, 1);
+        if (n < 0 || n % record != 0)
+        {
+            return -1;
+        }
+        for (char *p = wire; p < wire + n; p += record, received++)
+        {
+            mypipe_frame_header length;
+            memcpy(&length, p, sizeof(length));
+            if (length != size)
+            {
+                return -1;
+            }
+            memcpy(buf + received * size, p + sizeof(length), size);
+        }
+    }
+    return 0;
+}
+
+static char pattern_byte(uint64_t seq, size_t offset)
+{
+    return (char)((seq + offset) * 31 + 97);
+}
+
+// sends one message, or one batch of them
+static int send_messages(struct transport *t, const struct options *opt, char *messages, int number)
+{
+    if (opt->batch > 1)
+    {
+        struct iovec iov[MAX_BATCH];
+        for (int k = 0; k < number; k++)
+        {
+            iov[k].iov_base = messages + k * opt->message_size;
+            iov[k].iov_len = opt->message_size;
+        }
+        return send_batch(t, iov, number, opt->framed);
+    }
+    if (opt->framed)
+    {
+        return mypipe_ring_write_frame_wait((struct mypipe_ring *)t->shared, messages, opt->message_size) == (ssize_t)opt->message_size ? 0 : -1;
+    }
+    return send_all(t, messages, opt->message_size);
+}
+
+static int recv_messages(struct transport *t, const struct options *opt, char *messages, int number, char *wire)
+{
+    if (opt->batch > 1)
+    {
+        return recv_batch(t, messages, opt->message_size, number, opt->framed, wire);
+    }
+    if (opt->framed)
+    {
+        return mypipe_ring_read_frame_wait((struct mypipe_ring *)t->shared, messages, opt->message_size) == (ssize_t)opt->message_size ? 0 : -1;
+    }
+    return recv_all(t, messages, opt->message_size);
+}
+
+static void run_writer(struct transport *t, const struct options *opt)
+{
+    char *messages = malloc(opt->message_size * opt->batch);
+    struct message_header header;
+    for (int k = 0; k < opt->batch; k++)
+    {
+        for (size_t j = sizeof(header); j < opt->message_size; j++)
+        {
+            messages[k * opt->message_size + j] = pattern_byte(0, j);
+        }
+    }
+
+    for (long i = 0; i < opt->message_number; i += opt->batch)
+    {
+        int number = min(opt->batch, opt->message_number - i);
+        for (int k = 0; k < number; k++)
+        {
+            char *message = messages + k * opt->message_size;
+            if (opt->check_payload)
+            {
+                for (size_t j = sizeof(header); j < opt->message_size; j++)
+                {
+                    message[j] = pattern_byte(i + k, j);
+                }
+            }
+            header.seq = i + k;
+            header.send_ns = now_ns();
+            memcpy(message, &header, sizeof(header));
+        }
+        if (send_messages(t, opt, messages, number) != 0)
+        {
+            perror("[ERROR] Fail to send message");
+            break;
+        }
+    }
+    free(messages);
+}
+
+static int compare_uint64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static uint64_t percentile(const uint64_t *sorted, long n, double p)
+{
+    long index = (long)(p * (n - 1));
+    return sorted[index];
+}
+
+static int run_reader(struct transport *t, const struct options *opt)
+{
+    char *messages = malloc(opt->message_size * opt->batch);
+    char *wire = malloc((sizeof(mypipe_frame_header) + opt->message_size) * opt->batch);
+    uint64_t *latency = malloc(opt->message_number * sizeof(uint64_t));
+    struct message_header header;
+    uint64_t first_send_ns = 0;
+    uint64_t last_recv_ns = 0;
+    long seq_errors = 0;
+    long payload_errors = 0;
+    long received = 0;
+
+    for (long i = 0; i < opt->message_number; i += opt->batch)
+    {
+        int number = min(opt->batch, opt->message_number - i);
+        if (recv_messages(t, opt, messages, number, wire) != 0)
+        {
+            fprintf(stderr, "[ERROR] Stream ended after %ld messages.\n", i);
+            break;
+        }
+        last_recv_ns = now_ns();
+        for (int k = 0; k < number; k++)
+        {
+            const char *message = messages + k * opt->message_size;
+            memcpy(&header, message, sizeof(header));
+            if (i + k == 0)
+            {
+                first_send_ns = header.send_ns;
+            }
+            latency[i + k] = last_recv_ns - header.send_ns;
+            received++;
+
+            if (header.seq != (uint64_t)(i + k))
+            {
+                seq_errors++;
+            }
+            if (opt->check_payload)
+            {
+                for (size_t j = sizeof(header); j < opt->message_size; j++)
+                {
+                    if (message[j] != pattern_byte(header.seq, j))
+                    {
+                        payload_errors++;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    if (received > 0)
+    {
+        qsort(latency, received, sizeof(uint64_t), compare_uint64);
+        double seconds = (last_recv_ns - first_send_ns) / 1e9;
+        double megabytes = (double)received * opt->message_size / (1024.0 * 1024.0);
+        printf("transport %s%s message_size %zu messages %ld batch %d\n", transport_names[opt->type], opt->framed ? " framed" : "", opt->message_size, received, opt->batch);
+        printf("throughput %.2f MB/s %.0f msg/s\n", megabytes / seconds, received / seconds);
+        printf("latency(ns) p50 %lu p90 %lu p99 %lu p99.9 %lu max %lu\n",
+               percentile(latency, received, 0.5), percentile(latency, received, 0.9),
+               percentile(latency, received, 0.99), percentile(latency, received, 0.999),
+               latency[received - 1]);
+        printf("integrity seq_errors %ld payload_errors %ld\n", seq_errors, payload_errors);
+    }
+
+    free(messages);
+    free(wire);
+    free(latency);
+    return (received == opt->message_number && seq_errors == 0 && payload_errors == 0) ? 0 : 1;
+}
+
+static int parse_transport(const char *name, enum transport_type *type)
+{
+    for (int i = 0; i < (int)(sizeof(transport_names) / sizeof(transport_names[0])); i++)
+    {
+        if (strcmp(name, transport_names[i]) == 0)
+        {
+            *type = (enum transport_type)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct options opt = {
+        .type = TRANSPORT_PIPE,
+        .message_size = 64,
+        .message_number = 100000,
+        .ring_size = DEFAULT_RING_SIZE,
+        .writer_cpu = -1,
+        .reader_cpu = -1,
+        .check_payload = 0,
+        .framed = 0,
+        .batch = 1,
+    };
+
+    int c;
+    while ((c = getopt(argc, argv, "t:s:n:b:w:r:cfv:")) != -1)
+    {
+        switch (c)
+        {
+        case 't':
+            if (parse_transport(optarg, &opt.type) != 0)
+            {
+                fprintf(stderr, "[ERROR] Unknown transport %s.\n", optarg);
+                exit(1);
+            }
+            break;
+        case 's':
+            opt.message_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'n':
+            opt.message_number = strtol(optarg, NULL, 10);
+            break;
+        case 'b':
+            opt.ring_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            opt.writer_cpu = atoi(optarg);
+            break;
+        case 'r':
+            opt.reader_cpu = atoi(optarg);
+            break;
+        case 'c':
+            opt.check_payload = 1;
+            break;
+        case 'f':
+            opt.framed = 1;
+            break;
+        case 'v':
+            opt.batch = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-t mypipe|pipe|socketpair|shm] [-s size] [-n number] [-b ring_size] [-w cpu] [-r cpu] [-c] [-f] [-v batch]\n", argv[0]);
+            exit(1);
+        }
+    }
+    if (opt.message_size < sizeof(struct message_header) || opt.message_number <= 0 || opt.ring_size == 0)
+    {
+        fprintf(stderr, "[ERROR] Message size must be at least %zu bytes.\n", sizeof(struct message_header));
+        exit(1);
+    }
+    if (opt.batch < 1 || opt.batch > MAX_BATCH || (opt.batch > 1 && opt.type == TRANSPORT_SHM) || (opt.framed && opt.type != TRANSPORT_MYPIPE))
+    {
+        fprintf(stderr, "[ERROR] Batches of 1 to %d messages need mypipe, pipe or socketpair; framing needs mypipe.\n", MAX_BATCH);
+        exit(1);
+    }
+    if (opt.framed && opt.message_size + sizeof(mypipe_frame_header) > opt.ring_size)
+    {
+        fprintf(stderr, "[ERROR] A record of %zu bytes does not fit in the ring.\n", opt.message_size);
+        exit(1);
+    }
+
+    struct transport t;
+    if (transport_open(&t, &opt) != 0)
+    {
+        perror("[ERROR] Fail to open transport");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        perror("[ERROR] Fail to fork");
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        pin_to_cpu(opt.writer_cpu);
+        if (t.shared == NULL)
+        {
+            close(t.fds[0]);
+        }
+        run_writer(&t, &opt);
+        _exit(0);
+    }
+
+    pin_to_cpu(opt.reader_cpu);
+    if (t.shared == NULL)
+    {
+        close(t.fds[1]);
+        t.fds[1] = -1;
+    }
+    int ret = run_reader(&t, &opt);
+    waitpid(pid, NULL, 0);
+    transport_close(&t);
+    return ret;
+}
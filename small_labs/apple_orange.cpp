@@ -3,51 +3,30 @@
 #include <iostream>
 #include <stdexcept>
 #include <condition_variable>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <initializer_list>
+#include "../common/sync.hpp"
 
-class Semaphore
+// the plate uses the shared primitives library, the backend is chosen at compile time
+// (-DSYNC_BACKEND_FUTEX / -DSYNC_BACKEND_SPIN, condvar by default)
+using Semaphore = primitives::Semaphore<primitives::DefaultBackend>;
+
+class Problem
 {
 public:
-    Semaphore(const Semaphore &) = delete;
-    Semaphore &operator=(const Semaphore &) = delete;
-    ~Semaphore() = default;
-
-    Semaphore(int initCnt, int maxCnt) : cnt(initCnt), max(maxCnt)
+    Problem()
     {
-        if (initCnt < 0 || maxCnt <= 0 || initCnt > maxCnt)
-        {
-            throw std::invalid_argument{"Invalid argument!"};
-        }
+        apple.SetName("apple");
+        orange.SetName("orange");
+        empty.SetName("empty");
+        mutex.SetName("mutex");
     }
 
-    void Down()
-    {
-        std::unique_lock<std::mutex> lg{mtx};
-        cv.wait(lg, [this]
-                { return cnt != 0; });
-        --cnt;
-    }
-
-    void Up()
-    {
-        std::unique_lock<std::mutex> lg{mtx};
-        if (cnt == max)
-        {
-            throw std::overflow_error{"The semaphore is full!"};
-        }
-        ++cnt;
-        cv.notify_one();
-    }
-
-private:
-    int cnt;
-    int max;
-    std::condition_variable cv;
-    mutable std::mutex mtx;
-};
-
-class Problem
-{
-public:
     void father()
     {
         while(1)
@@ -107,18 +86,377 @@ private:
     Semaphore mutex{1, 1};
 };
 
-int main()
+// a bounded lock-free multi-producer multi-consumer queue (Vyukov's algorithm)
+template <typename T>
+class LockFreeQueue
+{
+public:
+    LockFreeQueue(const LockFreeQueue &) = delete;
+    LockFreeQueue &operator=(const LockFreeQueue &) = delete;
+
+    explicit LockFreeQueue(size_t min_capacity)
+    {
+        size_t capacity = 1;
+        while (capacity < min_capacity)
+        {
+            capacity <<= 1;
+        }
+        mask = capacity - 1;
+        cells = std::vector<Cell>(capacity);
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(const T &value)
+    {
+        size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+            if (diff == 0)
+            {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // full
+            }
+            else
+            {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool try_pop(T &value)
+    {
+        size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Cell &cell = cells[pos & mask];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (diff == 0)
+            {
+                if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    value = cell.value;
+                    cell.sequence.store(pos + mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false; // empty
+            }
+            else
+            {
+                pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // the semaphores guarantee room/items exist, but a slot may still be half-written by a peer
+    void push(const T &value)
+    {
+        while (!try_push(value))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    T pop()
+    {
+        T value;
+        while (!try_pop(value))
+        {
+            std::this_thread::yield();
+        }
+        return value;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+
+        Cell() = default;
+        Cell(Cell &&other) noexcept : sequence(other.sequence.load()), value(other.value) {}
+        Cell &operator=(Cell &&other) noexcept
+        {
+            sequence.store(other.sequence.load());
+            value = other.value;
+            return *this;
+        }
+    };
+
+    size_t mask;
+    std::vector<Cell> cells;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) std::atomic<size_t> dequeue_pos{0};
+};
+
+enum Fruit
 {
-    Problem p;
-    std::thread father{&Problem::father, &p};
-    std::thread mother{&Problem::mother, &p};
-    std::thread son{&Problem::son, &p};
-    std::thread daughter{&Problem::daughter, &p};
+    APPLE = 0,
+    ORANGE = 1
+};
 
-    father.join();
-    mother.join();
-    son.join();
-    daughter.join();
+struct PlateConfig
+{
+    int slots = 1;
+    int fathers = 1; // apple producers
+    int mothers = 1; // orange producers
+    int daughters = 1; // apple consumers
+    int sons = 1; // orange consumers
+    int batch = 1;
+    long items = 0; // fruits per producer, 0 means forever
+    bool fast = false; // no sleeps and no printing, report operations per second
+};
+
+// an N-slot plate shared by M producers and K consumers, every fruit type has its own lock-free
+// queue so apples only go to daughters and oranges only go to sons
+class Plate
+{
+public:
+    explicit Plate(const PlateConfig &config) : config(config), empty{config.slots, config.slots}
+    {
+        if (config.batch <= 0 || config.batch > config.slots)
+        {
+            throw std::invalid_argument{"Batch size must be between 1 and the number of slots!"};
+        }
+        for (int type = 0; type < 2; ++type)
+        {
+            queue[type] = std::make_unique<LockFreeQueue<long>>(config.slots);
+            fruit[type] = std::make_unique<Semaphore>(0, config.slots);
+            fruit[type]->SetName(type == APPLE ? "apples" : "oranges");
+        }
+        empty.SetName("empty");
+        unclaimed[APPLE] = config.items * config.fathers;
+        unclaimed[ORANGE] = config.items * config.mothers;
+    }
+
+    void run()
+    {
+        std::vector<std::thread> threads;
+        for (int i = 0; i < config.fathers; ++i)
+        {
+            threads.emplace_back(&Plate::produce, this, APPLE, i);
+        }
+        for (int i = 0; i < config.mothers; ++i)
+        {
+            threads.emplace_back(&Plate::produce, this, ORANGE, i);
+        }
+        for (int i = 0; i < config.daughters; ++i)
+        {
+            threads.emplace_back(&Plate::consume, this, APPLE, i);
+        }
+        for (int i = 0; i < config.sons; ++i)
+        {
+            threads.emplace_back(&Plate::consume, this, ORANGE, i);
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        for (auto &t : threads)
+        {
+            t.join();
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        long total = eaten[APPLE] + eaten[ORANGE];
+        std::cout << "slots " << config.slots << ", producers " << config.fathers + config.mothers
+                  << ", consumers " << config.daughters + config.sons << ", batch " << config.batch << std::endl;
+        std::cout << "eaten " << eaten[APPLE] << " apples and " << eaten[ORANGE] << " oranges in " << seconds << " s, "
+                  << total / seconds << " ops/s, " << handoffs / seconds << " batches/s" << std::endl;
+    }
+
+private:
+    void produce(Fruit type, int id)
+    {
+        const char *name = type == APPLE ? "father" : "mother";
+        for (long made = 0; config.items == 0 || made < config.items;)
+        {
+            int n = config.batch;
+            if (config.items != 0 && config.items - made < n)
+            {
+                n = config.items - made;
+            }
+            if (!config.fast)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 1000)); // prepare the fruit, off the plate
+            }
+            empty.Down(n); // occupy n empty positions at once
+            for (int i = 0; i < n; ++i)
+            {
+                queue[type]->push(made + i);
+            }
+            if (!config.fast)
+            {
+                print({"[", name, std::to_string(id), "] put ", std::to_string(n), type == APPLE ? " apple(s)" : " orange(s)", " on the plate"});
+            }
+            fruit[type]->Up(n);
+            made += n;
+        }
+    }
+
+    void consume(Fruit type, int id)
+    {
+        const char *name = type == APPLE ? "daughter" : "son";
+        while (true)
+        {
+            int n = claim(type);
+            if (n == 0)
+            {
+                break;
+            }
+            int taken = fruit[type]->DownUpTo(n);
+            if (taken < n)
+            {
+                unclaimed[type] += n - taken; // give back what is not on the plate yet
+            }
+            for (int i = 0; i < taken; ++i)
+            {
+                queue[type]->pop();
+            }
+            empty.Up(taken);
+            eaten[type] += taken;
+            handoffs++;
+            if (!config.fast)
+            {
+                print({"[", name, std::to_string(id), "] eat ", std::to_string(taken), type == APPLE ? " apple(s)" : " orange(s)"});
+                std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 1000));
+            }
+        }
+    }
+
+    // reserve up to `batch` of the fruits that are still to be eaten, 0 means all are taken
+    int claim(Fruit type)
+    {
+        if (config.items == 0)
+        {
+            return config.batch;
+        }
+        long left = unclaimed[type].load();
+        while (left > 0)
+        {
+            long n = left < config.batch ? left : config.batch;
+            if (unclaimed[type].compare_exchange_weak(left, left - n))
+            {
+                return n;
+            }
+        }
+        return 0;
+    }
+
+    void print(std::initializer_list<std::string> str_list)
+    {
+        std::unique_lock<std::mutex> lock(print_mtx);
+        for (auto &str : str_list)
+        {
+            std::cout << str;
+        }
+        std::cout << std::endl;
+    }
+
+    PlateConfig config;
+    Semaphore empty;
+    std::unique_ptr<Semaphore> fruit[2];
+    std::unique_ptr<LockFreeQueue<long>> queue[2];
+    std::atomic<long> unclaimed[2];
+    std::atomic<long> eaten[2]{{0}, {0}};
+    std::atomic<long> handoffs{0};
+    std::mutex print_mtx;
+};
+
+// usage: ./apple_orange                                  the classic one-slot plate
+//        ./apple_orange -n slots -p fathers -m mothers -d daughters -s sons -b batch -i items [-f]
+static void print_usage(const char *program)
+{
+    std::cout << "usage: " << program << " [-n slots] [-p fathers] [-m mothers] [-d daughters] [-s sons] [-b batch] [-i items] [-f]" << std::endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 1)
+    {
+        Problem p;
+        std::thread father{&Problem::father, &p};
+        std::thread mother{&Problem::mother, &p};
+        std::thread son{&Problem::son, &p};
+        std::thread daughter{&Problem::daughter, &p};
+
+        father.join();
+        mother.join();
+        son.join();
+        daughter.join();
+
+        return 0;
+    }
+
+    PlateConfig config;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "-f")
+        {
+            config.fast = true;
+            continue;
+        }
+        if (i + 1 >= argc)
+        {
+            std::cout << "missing value for " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+        long value = std::atol(argv[++i]);
+        if (arg == "-n") config.slots = value;
+        else if (arg == "-p") config.fathers = value;
+        else if (arg == "-m") config.mothers = value;
+        else if (arg == "-d") config.daughters = value;
+        else if (arg == "-s") config.sons = value;
+        else if (arg == "-b") config.batch = value;
+        else if (arg == "-i") config.items = value;
+        else
+        {
+            std::cout << "unknown option " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (config.fast && config.items == 0)
+    {
+        config.items = 1000000;
+    }
+    if (config.slots < 1 || config.batch < 1 || config.batch > config.slots)
+    {
+        std::cout << "the plate needs at least one slot, and the batch size must be between 1 and the number of slots" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (config.fathers < 0 || config.mothers < 0 || config.daughters < 0 || config.sons < 0 || config.items < 0)
+    {
+        std::cout << "the numbers of producers, consumers and items cannot be negative" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+    if ((config.fathers > 0 && config.daughters == 0) || (config.mothers > 0 && config.sons == 0))
+    {
+        std::cout << "every fruit type that is produced needs a consumer" << std::endl;
+        print_usage(argv[0]);
+        return 1;
+    }
 
+    Plate plate(config);
+    plate.run();
     return 0;
 }